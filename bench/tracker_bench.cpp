@@ -0,0 +1,268 @@
+#include "tracker_data.hpp"
+#include "host.hpp"
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Times the hot TrackingList operations over generated trees and counts what they allocate.
+//
+//   tracker_bench [--shape flat|balanced|deep] [--leaves N] [--iterations N]
+//                 [--save FILE] [--check FILE]
+//
+// Without --shape or --leaves every shape runs at 6, 16, 32 and 64 leaves, 64 being the most a
+// NodeIndex can address. --save writes the results as a baseline; --check compares against one,
+// failing on any change in allocations and reporting the change in time.
+
+enum Shape { FLAT, BALANCED, DEEP };
+
+static char const* const SHAPE_NAMES[] = { "flat", "balanced", "deep" };
+static const int DEFAULT_LEAVES[] = { 6, 16, 32, 64 };
+static const int BUFFER_SIZE = 1024;
+
+struct Result {
+	double nsPerOp;
+	double allocationsPerOp;
+	double bytesPerOp;
+};
+
+// Flat has no pairs. Balanced pairs neighbours level by level; deep pairs the previous pair with
+// the next leaf, so its height is the leaf count.
+static TrackingList* createTree(Shape shape, int leaves) {
+	PairMap none;
+	TrackingList* list = new TrackingList(leaves, none);
+	char name[8];
+	for (int i = 0; i < leaves; ++i) {
+		snprintf(name, sizeof(name), "l%d", i);
+		list->addElement(name, i % 4);
+	}
+	int pairs = 0;
+	if (shape == BALANCED) {
+		vector<NodeIndex> level;
+		for (int i = 0; i < leaves; ++i)
+			level.push_back(i);
+		while (level.size() > 1) {
+			vector<NodeIndex> next;
+			for (size_t i = 0; i + 1 < level.size(); i += 2) {
+				snprintf(name, sizeof(name), "p%d", pairs);
+				list->addPair(level[i], level[i + 1], name);
+				next.push_back(leaves + pairs++);
+			}
+			if (level.size() % 2 == 1)
+				next.push_back(level.back());
+			level = next;
+		}
+	}
+	else if (shape == DEEP) {
+		NodeIndex previous = 0;
+		for (int i = 1; i < leaves; ++i) {
+			snprintf(name, sizeof(name), "p%d", pairs);
+			list->addPair(previous, i, name);
+			previous = leaves + pairs++;
+		}
+	}
+	return list;
+}
+
+// Times every call on its own when the list has to be put back first, else the whole batch. Only
+// what the operation itself allocates is counted.
+static Result measure(int iterations, function<void()> setup, function<void()> op) {
+	typedef chrono::steady_clock Clock;
+	Clock::duration elapsed = Clock::duration::zero();
+	uint32_t allocations = 0, bytes = 0;
+	if (setup) {
+		for (int i = 0; i < iterations; ++i) {
+			setup();
+			uint32_t allocationsBefore = allocationCount, bytesBefore = allocatedBytes;
+			Clock::time_point start = Clock::now();
+			op();
+			elapsed += Clock::now() - start;
+			allocations += allocationCount - allocationsBefore;
+			bytes += allocatedBytes - bytesBefore;
+		}
+	}
+	else {
+		uint32_t allocationsBefore = allocationCount, bytesBefore = allocatedBytes;
+		Clock::time_point start = Clock::now();
+		for (int i = 0; i < iterations; ++i)
+			op();
+		elapsed = Clock::now() - start;
+		allocations = allocationCount - allocationsBefore;
+		bytes = allocatedBytes - bytesBefore;
+	}
+	Result result = {
+		chrono::duration<double, nano>(elapsed).count() / iterations,
+		(double)allocations / iterations,
+		(double)bytes / iterations
+	};
+	return result;
+}
+
+struct Case {
+	string name;
+	Result result;
+};
+
+typedef vector<Case> Results;
+
+static void add(Results& results, char const* op, Shape shape, int leaves, Result result) {
+	char name[64];
+	snprintf(name, sizeof(name), "%s/%s/%d", op, SHAPE_NAMES[shape], leaves);
+	Case entry = { name, result };
+	results.push_back(entry);
+}
+
+static Case const* find(Results const& results, string const& name) {
+	for (Case const& entry : results) {
+		if (entry.name == name)
+			return &entry;
+	}
+	return NULL;
+}
+
+// buildAll, buildPair and the serializations start from the split list, breakAll and breakPair
+// from the fully merged one. The pairs are compiled up front, and one slot is active so that
+// updateTime takes the accruing path.
+static void runTree(Shape shape, int leaves, int iterations, Results& results) {
+	TrackingList* list = createTree(shape, leaves);
+	list->buildAll();
+	list->incIndex();
+	list->switchIndex();
+	schar buffer[BUFFER_SIZE];
+	int size = 0;
+	function<void()> split = [list] { list->breakAll(); };
+	function<void()> merged = [list] { list->buildAll(); };
+	volatile int sink = 0;
+
+	add(results, "buildPair", shape, leaves, measure(iterations, split, [list] { list->buildPair(0, 1); }));
+	add(results, "breakPair", shape, leaves, measure(iterations, merged, [list] { list->breakPair(0); }));
+	add(results, "buildAll", shape, leaves, measure(iterations, split, [list] { list->buildAll(); }));
+	add(results, "breakAll", shape, leaves, measure(iterations, merged, [list] { list->breakAll(); }));
+	list->buildAll();
+	add(results, "serialize", shape, leaves, measure(iterations, NULL, [&] {
+		size = list->serialize(buffer, sizeof(buffer));
+	}));
+	add(results, "deserialize", shape, leaves, measure(iterations, NULL, [&] {
+		sink = list->deserialize(buffer, size);
+	}));
+	add(results, "totalTime", shape, leaves, measure(iterations, NULL, [&] { sink = list->totalTime(); }));
+	add(results, "totalHeight", shape, leaves, measure(iterations, NULL, [&] { sink = list->totalHeight(); }));
+	add(results, "updateTime", shape, leaves, measure(iterations, NULL, [&] { sink = list->updateTime(); }));
+	delete list;
+}
+
+static void print(FILE* out, Results const& results) {
+	fprintf(out, "# case ns/op allocs/op bytes/op\n");
+	for (Case const& entry : results)
+		fprintf(out, "%s %.1f %.2f %.1f\n", entry.name.c_str(), entry.result.nsPerOp, entry.result.allocationsPerOp, entry.result.bytesPerOp);
+}
+
+static bool load(char const* path, Results& results) {
+	FILE* in = fopen(path, "r");
+	if (!in)
+		return false;
+	char line[256], name[128];
+	Result result;
+	while (fgets(line, sizeof(line), in)) {
+		if (line[0] != '#' && sscanf(line, "%127s %lf %lf %lf", name, &result.nsPerOp, &result.allocationsPerOp, &result.bytesPerOp) == 4) {
+			Case entry = { name, result };
+			results.push_back(entry);
+		}
+	}
+	fclose(in);
+	return true;
+}
+
+// Allocations are exact and must match; times only inform, since they depend on the machine.
+static int check(Results const& results, Results const& baseline) {
+	int failures = 0;
+	for (Case const& entry : results) {
+		Case const* found = find(baseline, entry.name);
+		if (!found) {
+			printf("%-28s new\n", entry.name.c_str());
+			continue;
+		}
+		Result const& now = entry.result;
+		Result const& before = found->result;
+		bool same = now.allocationsPerOp == before.allocationsPerOp && now.bytesPerOp == before.bytesPerOp;
+		printf("%-28s %+7.1f%% time  %.2f -> %.2f allocs  %.1f -> %.1f bytes%s\n", entry.name.c_str(),
+			before.nsPerOp > 0 ? 100 * (now.nsPerOp / before.nsPerOp - 1) : 0,
+			before.allocationsPerOp, now.allocationsPerOp, before.bytesPerOp, now.bytesPerOp, same ? "" : "  CHANGED");
+		failures += !same;
+	}
+	return failures;
+}
+
+int main(int argc, char** argv) {
+	vector<Shape> shapes;
+	vector<int> leaves;
+	int iterations = 2000;
+	char const* savePath = NULL;
+	char const* checkPath = NULL;
+	for (int i = 1; i + 1 < argc; i += 2) {
+		string option = argv[i];
+		char const* value = argv[i + 1];
+		if (option == "--shape") {
+			for (int s = FLAT; s <= DEEP; ++s) {
+				if (strcmp(value, SHAPE_NAMES[s]) == 0)
+					shapes.push_back((Shape)s);
+			}
+		}
+		else if (option == "--leaves") {
+			leaves.push_back(atoi(value));
+		}
+		else if (option == "--iterations") {
+			iterations = atoi(value);
+		}
+		else if (option == "--save") {
+			savePath = value;
+		}
+		else if (option == "--check") {
+			checkPath = value;
+		}
+		else {
+			fprintf(stderr, "unknown option %s\n", argv[i]);
+			return 2;
+		}
+	}
+	if (shapes.empty())
+		shapes = { FLAT, BALANCED, DEEP };
+	if (leaves.empty())
+		leaves.assign(DEFAULT_LEAVES, DEFAULT_LEAVES + sizeof(DEFAULT_LEAVES) / sizeof(DEFAULT_LEAVES[0]));
+
+	host::reset();
+	Results results;
+	for (Shape shape : shapes) {
+		for (int count : leaves) {
+			if (count < 2 || 2 * count - 1 > 127) {
+				fprintf(stderr, "leaves must be 2 to 64: %d\n", count);
+				return 2;
+			}
+			runTree(shape, count, iterations, results);
+		}
+	}
+
+	if (savePath) {
+		FILE* out = fopen(savePath, "w");
+		if (!out) {
+			fprintf(stderr, "cannot write %s\n", savePath);
+			return 2;
+		}
+		print(out, results);
+		fclose(out);
+	}
+	if (checkPath) {
+		Results baseline;
+		if (!load(checkPath, baseline)) {
+			fprintf(stderr, "cannot read %s\n", checkPath);
+			return 2;
+		}
+		return check(results, baseline) != 0;
+	}
+	if (!savePath)
+		print(stdout, results);
+	return 0;
+}
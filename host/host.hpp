@@ -0,0 +1,81 @@
+#pragma once
+
+extern "C" {
+	#include "pebble.h"
+}
+
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Control surface of the host Pebble shim: a virtual clock, an in-memory persist store, a
+// headless MenuLayer renderer and an AppMessage loopback standing in for the phone.
+namespace host {
+
+struct Stats {
+	int wakeups;
+	int ticks;
+	int timers;
+	int clicks;
+	int reloads;
+	int renders;
+	int headerDraws;
+	int rowDraws;
+	int rowCountQueries;
+	int cellHeightQueries;
+	int persistWrites;
+	int persistBytesWritten;
+	int persistReads;
+	int vibes;
+	int logs;
+	int messagesIn;
+	int bytesIn;
+	int messagesOut;
+	int bytesOut;
+};
+
+// Drops every window, callback, timer, message and persisted key and restarts the clock.
+void reset(time_t start = 0);
+// Tears the app down the way the OS does on exit, keeping the clock, persist store and phone.
+void terminate();
+const Stats& stats();
+void resetStats();
+
+// Runs in place of the Pebble event loop when the app calls app_event_loop().
+void setEventLoop(std::function<void()> loop);
+bool running();
+
+time_t now();
+uint64_t nowMs();
+// Moves the virtual clock forward, delivering tick and timer events in order and redrawing after each.
+void advance(int seconds);
+void advanceMs(uint64_t ms);
+
+// Clicks of the same button within the multi-click timeout of the window count as one multi-click;
+// single clicks still fire at once rather than after the timeout.
+void click(ButtonId button);
+void longClick(ButtonId button);
+void setConnected(bool connected);
+
+// Called for every message the app sends; returning false nacks it.
+void setPhone(std::function<bool(DictionaryIterator*)> phone);
+// Keeps a sent message undelivered, and the outbox busy, until released.
+void holdOutbox(bool held);
+// The largest outbox the firmware grants; older firmware has smaller ones. Kept across terminate().
+void setOutboxSizeMaximum(uint32_t size);
+AppMessageResult sendToWatch(const uint8_t* buffer, uint16_t size);
+
+bool persistHas(uint32_t key);
+std::vector<uint8_t> persistGet(uint32_t key);
+void persistSet(uint32_t key, const std::vector<uint8_t>& value);
+int persistUsed();
+// Drops every persist write and delete until the app terminates, as if the battery was pulled.
+void powerLoss();
+
+// Texts drawn during the last frame, header first, then rows top to bottom.
+const std::vector<std::string>& frame();
+std::vector<uint32_t> vibes();
+void setLogging(bool enabled);
+
+}
@@ -0,0 +1,405 @@
+#pragma once
+
+/* Host stand-in for the subset of the Pebble SDK used by the tracker. Declarations follow the
+ * SDK 3 headers; the behaviour behind them lives in pebble_host.cpp and is driven through host.hpp. */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef int32_t status_t;
+
+typedef enum StatusCode {
+	S_SUCCESS = 0,
+	E_ERROR = -1,
+	E_UNKNOWN = -2,
+	E_INTERNAL = -3,
+	E_INVALID_ARGUMENT = -4,
+	E_OUT_OF_MEMORY = -5,
+	E_OUT_OF_STORAGE = -6,
+	E_OUT_OF_RESOURCES = -7,
+	E_RANGE = -8,
+	E_DOES_NOT_EXIST = -9,
+	E_INVALID_OPERATION = -10,
+	E_BUSY = -11,
+	S_TRUE = 1,
+	S_FALSE = 0,
+	S_NO_MORE_ITEMS = 2,
+	S_NO_ACTION_REQUIRED = 3
+} StatusCode;
+
+/* Logging */
+
+typedef enum {
+	APP_LOG_LEVEL_ERROR = 1,
+	APP_LOG_LEVEL_WARNING = 50,
+	APP_LOG_LEVEL_INFO = 100,
+	APP_LOG_LEVEL_DEBUG = 200,
+	APP_LOG_LEVEL_DEBUG_VERBOSE = 255
+} AppLogLevel;
+
+void app_log(uint8_t log_level, const char* src_filename, int src_line_number, const char* fmt, ...);
+
+#define APP_LOG(level, fmt, ...) app_log(level, __FILE__, __LINE__, fmt, ## __VA_ARGS__)
+
+/* Memory */
+
+size_t heap_bytes_used(void);
+
+/* Wall time */
+
+typedef enum {
+	SECOND_UNIT = 1 << 0,
+	MINUTE_UNIT = 1 << 1,
+	HOUR_UNIT = 1 << 2,
+	DAY_UNIT = 1 << 3,
+	MONTH_UNIT = 1 << 4,
+	YEAR_UNIT = 1 << 5
+} TimeUnits;
+
+typedef void (*TickHandler)(struct tm* tick_time, TimeUnits units_changed);
+
+void tick_timer_service_subscribe(TimeUnits tick_units, TickHandler handler);
+void tick_timer_service_unsubscribe(void);
+
+uint16_t time_ms(time_t* tloc, uint16_t* out_ms);
+time_t time_start_of_today(void);
+
+/* Timers */
+
+struct AppTimer;
+typedef struct AppTimer AppTimer;
+typedef void (*AppTimerCallback)(void* data);
+
+AppTimer* app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void* callback_data);
+bool app_timer_reschedule(AppTimer* timer_handle, uint32_t new_timeout_ms);
+void app_timer_cancel(AppTimer* timer_handle);
+
+/* Persistent storage */
+
+#define PERSIST_DATA_MAX_LENGTH 256
+#define PERSIST_STRING_MAX_LENGTH PERSIST_DATA_MAX_LENGTH
+
+bool persist_exists(const uint32_t key);
+int persist_get_size(const uint32_t key);
+bool persist_read_bool(const uint32_t key);
+int32_t persist_read_int(const uint32_t key);
+int persist_read_data(const uint32_t key, void* buffer, const size_t buffer_size);
+int persist_read_string(const uint32_t key, char* buffer, const size_t buffer_size);
+status_t persist_write_bool(const uint32_t key, const bool value);
+status_t persist_write_int(const uint32_t key, const int32_t value);
+int persist_write_data(const uint32_t key, const void* data, const size_t size);
+int persist_write_string(const uint32_t key, const char* cstring);
+status_t persist_delete(const uint32_t key);
+
+/* Dictionary */
+
+typedef enum {
+	DICT_OK = 0,
+	DICT_NOT_ENOUGH_STORAGE = 1 << 1,
+	DICT_INVALID_ARGS = 1 << 2,
+	DICT_INTERNAL_INCONSISTENCY = 1 << 3,
+	DICT_MALLOC_FAILED = 1 << 4
+} DictionaryResult;
+
+typedef enum {
+	TUPLE_BYTE_ARRAY = 0,
+	TUPLE_CSTRING = 1,
+	TUPLE_UINT = 2,
+	TUPLE_INT = 3
+} TupleType;
+
+typedef struct __attribute__((__packed__)) {
+	uint32_t key;
+	uint8_t type;
+	uint16_t length;
+	union {
+		uint8_t data[0];
+		char cstring[0];
+		uint8_t uint8;
+		uint16_t uint16;
+		uint32_t uint32;
+		int8_t int8;
+		int16_t int16;
+		int32_t int32;
+	} value[];
+} Tuple;
+
+struct Dictionary;
+typedef struct Dictionary Dictionary;
+
+typedef struct {
+	Dictionary* dictionary;
+	const void* end;
+	Tuple* cursor;
+} DictionaryIterator;
+
+uint32_t dict_calc_buffer_size(const uint8_t tuple_count, ...);
+DictionaryResult dict_write_begin(DictionaryIterator* iter, uint8_t* const buffer, const uint16_t size);
+DictionaryResult dict_write_data(DictionaryIterator* iter, const uint32_t key, const uint8_t* const data, const uint16_t size);
+DictionaryResult dict_write_cstring(DictionaryIterator* iter, const uint32_t key, const char* const cstring);
+DictionaryResult dict_write_int(DictionaryIterator* iter, const uint32_t key, const void* integer, const uint8_t width_bytes, const bool is_signed);
+DictionaryResult dict_write_uint8(DictionaryIterator* iter, const uint32_t key, const uint8_t value);
+DictionaryResult dict_write_uint16(DictionaryIterator* iter, const uint32_t key, const uint16_t value);
+DictionaryResult dict_write_uint32(DictionaryIterator* iter, const uint32_t key, const uint32_t value);
+DictionaryResult dict_write_int8(DictionaryIterator* iter, const uint32_t key, const int8_t value);
+DictionaryResult dict_write_int16(DictionaryIterator* iter, const uint32_t key, const int16_t value);
+DictionaryResult dict_write_int32(DictionaryIterator* iter, const uint32_t key, const int32_t value);
+uint32_t dict_write_end(DictionaryIterator* iter);
+Tuple* dict_read_begin_from_buffer(DictionaryIterator* iter, const uint8_t* const buffer, const uint16_t size);
+Tuple* dict_read_next(DictionaryIterator* iter);
+Tuple* dict_read_first(DictionaryIterator* iter);
+Tuple* dict_find(const DictionaryIterator* iter, const uint32_t key);
+
+/* AppMessage */
+
+#define APP_MESSAGE_INBOX_SIZE_MINIMUM 124
+#define APP_MESSAGE_OUTBOX_SIZE_MINIMUM 636
+
+typedef enum {
+	APP_MSG_OK = 0,
+	APP_MSG_SEND_TIMEOUT = 1 << 1,
+	APP_MSG_SEND_REJECTED = 1 << 2,
+	APP_MSG_NOT_CONNECTED = 1 << 3,
+	APP_MSG_APP_NOT_RUNNING = 1 << 4,
+	APP_MSG_INVALID_ARGS = 1 << 5,
+	APP_MSG_BUSY = 1 << 6,
+	APP_MSG_BUFFER_OVERFLOW = 1 << 7,
+	APP_MSG_ALREADY_RELEASED = 1 << 9,
+	APP_MSG_CALLBACK_ALREADY_REGISTERED = 1 << 10,
+	APP_MSG_CALLBACK_NOT_REGISTERED = 1 << 11,
+	APP_MSG_OUT_OF_MEMORY = 1 << 12,
+	APP_MSG_CLOSED = 1 << 13,
+	APP_MSG_INTERNAL_ERROR = 1 << 14,
+	APP_MSG_INVALID_STATE = 1 << 15
+} AppMessageResult;
+
+typedef void (*AppMessageInboxReceived)(DictionaryIterator* iterator, void* context);
+typedef void (*AppMessageInboxDropped)(AppMessageResult reason, void* context);
+typedef void (*AppMessageOutboxSent)(DictionaryIterator* iterator, void* context);
+typedef void (*AppMessageOutboxFailed)(DictionaryIterator* iterator, AppMessageResult reason, void* context);
+
+AppMessageResult app_message_open(const uint32_t size_inbound, const uint32_t size_outbound);
+void app_message_deregister_callbacks(void);
+void* app_message_get_context(void);
+void* app_message_set_context(void* context);
+AppMessageInboxReceived app_message_register_inbox_received(AppMessageInboxReceived received_callback);
+AppMessageInboxDropped app_message_register_inbox_dropped(AppMessageInboxDropped dropped_callback);
+AppMessageOutboxSent app_message_register_outbox_sent(AppMessageOutboxSent sent_callback);
+AppMessageOutboxFailed app_message_register_outbox_failed(AppMessageOutboxFailed failed_callback);
+uint32_t app_message_inbox_size_maximum(void);
+uint32_t app_message_outbox_size_maximum(void);
+AppMessageResult app_message_outbox_begin(DictionaryIterator** iterator);
+AppMessageResult app_message_outbox_send(void);
+
+/* Connection */
+
+typedef void (*BluetoothConnectionHandler)(bool connected);
+
+bool bluetooth_connection_service_peek(void);
+void bluetooth_connection_service_subscribe(BluetoothConnectionHandler handler);
+void bluetooth_connection_service_unsubscribe(void);
+
+/* Vibes */
+
+typedef struct {
+	const uint32_t* durations;
+	uint32_t num_segments;
+} VibePattern;
+
+void vibes_cancel(void);
+void vibes_short_pulse(void);
+void vibes_long_pulse(void);
+void vibes_double_pulse(void);
+void vibes_enqueue_custom_pattern(VibePattern pattern);
+
+/* Graphics */
+
+typedef struct GPoint {
+	int16_t x;
+	int16_t y;
+} GPoint;
+
+#define GPoint(x, y) ((GPoint){(x), (y)})
+#define GPointZero GPoint(0, 0)
+
+typedef struct GSize {
+	int16_t w;
+	int16_t h;
+} GSize;
+
+#define GSize(w, h) ((GSize){(w), (h)})
+
+typedef struct GRect {
+	GPoint origin;
+	GSize size;
+} GRect;
+
+#define GRect(x, y, w, h) ((GRect){{(x), (y)}, {(w), (h)}})
+#define GRectZero GRect(0, 0, 0, 0)
+
+typedef union GColor8 {
+	uint8_t argb;
+} GColor8;
+
+typedef GColor8 GColor;
+
+#define GColorBlack ((GColor8){0xC0})
+#define GColorWhite ((GColor8){0xFF})
+#define GColorClear ((GColor8){0x00})
+#define GColorIslamicGreen ((GColor8){0xC8})
+#define GColorJaegerGreen ((GColor8){0xD9})
+#define GColorBlueMoon ((GColor8){0xC7})
+#define GColorPictonBlue ((GColor8){0xDB})
+#define GColorRajah ((GColor8){0xF9})
+#define GColorPastelYellow ((GColor8){0xFE})
+
+typedef enum {
+	GCornerNone = 0,
+	GCornersAll = 0x0F
+} GCornerMask;
+
+typedef enum {
+	GTextOverflowModeWordWrap,
+	GTextOverflowModeTrailingEllipsis,
+	GTextOverflowModeFill
+} GTextOverflowMode;
+
+typedef enum {
+	GTextAlignmentLeft,
+	GTextAlignmentCenter,
+	GTextAlignmentRight
+} GTextAlignment;
+
+struct GContext;
+typedef struct GContext GContext;
+struct GTextAttributes;
+typedef struct GTextAttributes GTextAttributes;
+struct FontInfo;
+typedef struct FontInfo* GFont;
+
+#define FONT_KEY_GOTHIC_14_BOLD "RESOURCE_ID_GOTHIC_14_BOLD"
+#define FONT_KEY_GOTHIC_18 "RESOURCE_ID_GOTHIC_18"
+#define FONT_KEY_GOTHIC_18_BOLD "RESOURCE_ID_GOTHIC_18_BOLD"
+#define FONT_KEY_GOTHIC_24 "RESOURCE_ID_GOTHIC_24"
+#define FONT_KEY_GOTHIC_24_BOLD "RESOURCE_ID_GOTHIC_24_BOLD"
+
+GFont fonts_get_system_font(const char* font_key);
+
+void graphics_context_set_stroke_color(GContext* ctx, GColor color);
+void graphics_context_set_fill_color(GContext* ctx, GColor color);
+void graphics_context_set_text_color(GContext* ctx, GColor color);
+void graphics_context_set_stroke_width(GContext* ctx, uint8_t stroke_width);
+void graphics_context_set_antialiased(GContext* ctx, bool enable);
+void graphics_fill_rect(GContext* ctx, GRect rect, uint16_t corner_radius, GCornerMask corner_mask);
+void graphics_draw_line(GContext* ctx, GPoint p0, GPoint p1);
+void graphics_draw_text(GContext* ctx, const char* text, GFont const font, const GRect box,
+			const GTextOverflowMode overflow_mode, const GTextAlignment alignment,
+			GTextAttributes* text_attributes);
+
+/* Layers and windows */
+
+struct Layer;
+typedef struct Layer Layer;
+typedef void (*LayerUpdateProc)(struct Layer* layer, GContext* ctx);
+
+Layer* layer_create(GRect frame);
+void layer_destroy(Layer* layer);
+void layer_mark_dirty(Layer* layer);
+void layer_set_update_proc(Layer* layer, LayerUpdateProc update_proc);
+GRect layer_get_bounds(const Layer* layer);
+void layer_add_child(Layer* parent, Layer* child);
+void layer_remove_from_parent(Layer* child);
+
+struct TextLayer;
+typedef struct TextLayer TextLayer;
+
+typedef enum {
+	BUTTON_ID_BACK = 0,
+	BUTTON_ID_UP,
+	BUTTON_ID_SELECT,
+	BUTTON_ID_DOWN,
+	NUM_BUTTONS
+} ButtonId;
+
+typedef void* ClickRecognizerRef;
+typedef void (*ClickHandler)(ClickRecognizerRef recognizer, void* context);
+typedef void (*ClickConfigProvider)(void* context);
+
+struct Window;
+typedef struct Window Window;
+typedef void (*WindowHandler)(struct Window* window);
+
+typedef struct WindowHandlers {
+	WindowHandler load;
+	WindowHandler appear;
+	WindowHandler disappear;
+	WindowHandler unload;
+} WindowHandlers;
+
+Window* window_create(void);
+void window_destroy(Window* window);
+void window_set_click_config_provider(Window* window, ClickConfigProvider click_config_provider);
+void window_set_window_handlers(Window* window, WindowHandlers handlers);
+Layer* window_get_root_layer(const Window* window);
+void window_single_click_subscribe(ButtonId button_id, ClickHandler handler);
+void window_long_click_subscribe(ButtonId button_id, uint16_t delay_ms, ClickHandler down_handler, ClickHandler up_handler);
+void window_multi_click_subscribe(ButtonId button_id, uint8_t min_clicks, uint8_t max_clicks, uint16_t timeout, bool last_click_only, ClickHandler handler);
+
+void window_stack_push(Window* window, bool animated);
+Window* window_stack_pop(bool animated);
+void window_stack_pop_all(const bool animated);
+bool window_stack_remove(Window* window, bool animated);
+
+/* MenuLayer */
+
+typedef struct MenuIndex {
+	uint16_t section;
+	uint16_t row;
+} MenuIndex;
+
+#define MenuIndex(section, row) ((MenuIndex){ (section), (row) })
+
+typedef enum {
+	MenuRowAlignNone,
+	MenuRowAlignCenter,
+	MenuRowAlignTop,
+	MenuRowAlignBottom
+} MenuRowAlign;
+
+struct MenuLayer;
+typedef struct MenuLayer MenuLayer;
+
+typedef uint16_t (*MenuLayerGetNumberOfSectionsCallback)(struct MenuLayer* menu_layer, void* callback_context);
+typedef uint16_t (*MenuLayerGetNumberOfRowsInSectionsCallback)(struct MenuLayer* menu_layer, uint16_t section_index, void* callback_context);
+typedef int16_t (*MenuLayerGetCellHeightCallback)(struct MenuLayer* menu_layer, MenuIndex* cell_index, void* callback_context);
+typedef int16_t (*MenuLayerGetHeaderHeightCallback)(struct MenuLayer* menu_layer, uint16_t section_index, void* callback_context);
+typedef void (*MenuLayerDrawRowCallback)(GContext* ctx, const Layer* cell_layer, MenuIndex* cell_index, void* callback_context);
+typedef void (*MenuLayerDrawHeaderCallback)(GContext* ctx, const Layer* cell_layer, uint16_t section_index, void* callback_context);
+typedef void (*MenuLayerSelectCallback)(struct MenuLayer* menu_layer, MenuIndex* cell_index, void* callback_context);
+
+typedef struct MenuLayerCallbacks {
+	MenuLayerGetNumberOfSectionsCallback get_num_sections;
+	MenuLayerGetNumberOfRowsInSectionsCallback get_num_rows;
+	MenuLayerGetCellHeightCallback get_cell_height;
+	MenuLayerGetHeaderHeightCallback get_header_height;
+	MenuLayerDrawRowCallback draw_row;
+	MenuLayerDrawHeaderCallback draw_header;
+	MenuLayerSelectCallback select_click;
+	MenuLayerSelectCallback select_long_click;
+} MenuLayerCallbacks;
+
+MenuLayer* menu_layer_create(GRect frame);
+void menu_layer_destroy(MenuLayer* menu_layer);
+Layer* menu_layer_get_layer(const MenuLayer* menu_layer);
+void menu_layer_set_callbacks(MenuLayer* menu_layer, void* callback_context, MenuLayerCallbacks callbacks);
+void menu_layer_reload_data(MenuLayer* menu_layer);
+void menu_layer_set_selected_index(MenuLayer* menu_layer, MenuIndex index, MenuRowAlign scroll_align, bool animated);
+MenuIndex menu_layer_get_selected_index(const MenuLayer* menu_layer);
+
+/* App */
+
+void app_event_loop(void);
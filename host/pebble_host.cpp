@@ -0,0 +1,1130 @@
+#include "host.hpp"
+
+#include <malloc.h>
+#include <stdarg.h>
+#include <stdio.h>
+#if defined(__SANITIZE_ADDRESS__)
+extern "C" size_t __sanitizer_get_current_allocated_bytes(void);
+#endif
+#include <algorithm>
+#include <deque>
+#include <map>
+
+using namespace std;
+
+static const int SCREEN_WIDTH = 144;
+static const int SCREEN_HEIGHT = 168;
+static const int PERSIST_STORAGE_SIZE = 4096;
+static const uint32_t INBOX_SIZE_MAXIMUM = 8200;
+static const uint32_t OUTBOX_SIZE_MAXIMUM = 8200;
+static const int TUPLE_HEADER_SIZE = 7;
+static const int SETTLE_LIMIT = 10000;
+// What the firmware waits for another click when a multi-click handler gives no timeout.
+static const uint64_t MULTI_CLICK_TIMEOUT_MS = 300;
+
+struct Dictionary {
+	uint8_t count;
+	Tuple head[];
+} __attribute__((__packed__));
+
+struct FontInfo {
+	const char* key;
+};
+
+struct GContext {
+	vector<string>* texts;
+};
+
+// A layer knows the window it was added to, so that it can leave it after the window was popped.
+struct Layer {
+	GRect frame;
+	LayerUpdateProc update_proc;
+	MenuLayer* menu;
+	Window* window;
+};
+
+struct MenuLayer {
+	Layer layer;
+	MenuLayerCallbacks callbacks;
+	void* context;
+	MenuIndex selected;
+	int scroll;
+	bool reload;
+	vector<int16_t> heights;
+};
+
+struct MultiClick {
+	ClickHandler handler;
+	uint8_t minClicks;
+	uint8_t maxClicks;
+	uint16_t timeout;
+	bool lastClickOnly;
+};
+
+struct Window {
+	Layer root;
+	WindowHandlers handlers;
+	ClickConfigProvider clickConfig;
+	ClickHandler single[NUM_BUTTONS];
+	ClickHandler longDown[NUM_BUTTONS];
+	MultiClick multi[NUM_BUTTONS];
+	vector<Layer*> children;
+	bool loaded;
+};
+
+struct AppTimer {
+	uint64_t deadline;
+	uint64_t order;
+	AppTimerCallback callback;
+	void* data;
+};
+
+namespace {
+
+struct State {
+	uint64_t nowMs = 0;
+	host::Stats stats = host::Stats();
+	bool logging = false;
+	function<void()> loop;
+
+	map<uint32_t, vector<uint8_t>> persist;
+	bool powerLost = false;
+
+	TimeUnits tickUnits = (TimeUnits)0;
+	TickHandler tickHandler = NULL;
+	uint64_t lastTickMs = 0;
+	vector<AppTimer*> timers;
+	uint64_t timerOrder = 0;
+
+	vector<Window*> stack;
+	Window* configuring = NULL;
+	Window* clickWindow = NULL;
+	ButtonId clickButton = BUTTON_ID_BACK;
+	uint64_t clickMs = 0;
+	int clickCount = 0;
+	vector<MenuLayer*> menus;
+	bool dirty = false;
+	vector<string> frame;
+
+	bool connected = true;
+	BluetoothConnectionHandler bluetoothHandler = NULL;
+
+	vector<uint32_t> vibes;
+
+	bool messageOpen = false;
+	void* messageContext = NULL;
+	AppMessageInboxReceived inboxReceived = NULL;
+	AppMessageInboxDropped inboxDropped = NULL;
+	AppMessageOutboxSent outboxSent = NULL;
+	AppMessageOutboxFailed outboxFailed = NULL;
+	uint32_t inboxSize = 0;
+	vector<uint8_t> outbox;
+	DictionaryIterator outboxIterator;
+	bool outboxOpen = false;
+	bool outboxPending = false;
+	bool outboxHeld = false;
+	uint32_t outboxSizeMaximum = OUTBOX_SIZE_MAXIMUM;
+	uint32_t outboxMessageSize = 0;
+	function<bool(DictionaryIterator*)> phone;
+};
+
+State state;
+FontInfo fonts[] = {
+	{ FONT_KEY_GOTHIC_14_BOLD },
+	{ FONT_KEY_GOTHIC_18 },
+	{ FONT_KEY_GOTHIC_18_BOLD },
+	{ FONT_KEY_GOTHIC_24 },
+	{ FONT_KEY_GOTHIC_24_BOLD }
+};
+
+int persistUsed() {
+	int used = 0;
+	for (auto& e : state.persist)
+		used += e.second.size();
+	return used;
+}
+
+int headerHeight(MenuLayer* menu) {
+	if (!menu->callbacks.get_header_height)
+		return 0;
+	return menu->callbacks.get_header_height(menu, 0, menu->context);
+}
+
+// Pebble re-queries the visible rows on every draw; a reload additionally measures the whole content.
+void layoutMenu(MenuLayer* menu, bool full) {
+	++state.stats.rowCountQueries;
+	uint16_t rows = menu->callbacks.get_num_rows ? menu->callbacks.get_num_rows(menu, 0, menu->context) : 0;
+	menu->heights.assign(rows, 0);
+	int bottom = menu->scroll + menu->layer.frame.size.h;
+	int y = headerHeight(menu);
+	for (uint16_t row = 0; row < rows && (full || y < bottom); ++row) {
+		MenuIndex index = MenuIndex(0, row);
+		++state.stats.cellHeightQueries;
+		menu->heights[row] = menu->callbacks.get_cell_height ? menu->callbacks.get_cell_height(menu, &index, menu->context) : 44;
+		y += menu->heights[row];
+	}
+	menu->reload = false;
+}
+
+void scrollToSelected(MenuLayer* menu) {
+	if (menu->heights.empty())
+		return;
+	int top = headerHeight(menu);
+	for (int row = 0; row < menu->selected.row; ++row)
+		top += menu->heights[row];
+	int bottom = top + menu->heights[menu->selected.row];
+	int height = menu->layer.frame.size.h;
+	if (menu->selected.row == 0)
+		menu->scroll = 0;
+	else if (top < menu->scroll)
+		menu->scroll = top;
+	else if (bottom > menu->scroll + height)
+		menu->scroll = bottom - height;
+}
+
+void drawMenu(MenuLayer* menu, GContext* ctx) {
+	layoutMenu(menu, menu->reload);
+	int height = menu->layer.frame.size.h;
+	int width = menu->layer.frame.size.w;
+	int y = 0;
+	int header = headerHeight(menu);
+	if (header > 0 && menu->scroll < header && menu->callbacks.draw_header) {
+		Layer cell = { GRect(0, 0, width, header), NULL, NULL, NULL };
+		++state.stats.headerDraws;
+		menu->callbacks.draw_header(ctx, &cell, 0, menu->context);
+	}
+	y += header;
+	for (uint16_t row = 0; row < menu->heights.size() && y < menu->scroll + height; ++row) {
+		int h = menu->heights[row];
+		if (y + h > menu->scroll && h > 0 && menu->callbacks.draw_row) {
+			Layer cell = { GRect(0, 0, width, h), NULL, NULL, NULL };
+			MenuIndex index = MenuIndex(0, row);
+			++state.stats.rowDraws;
+			menu->callbacks.draw_row(ctx, &cell, &index, menu->context);
+		}
+		y += h;
+	}
+}
+
+void render() {
+	if (!state.dirty || state.stack.empty())
+		return;
+	state.dirty = false;
+	++state.stats.renders;
+	state.frame.clear();
+	GContext ctx = { &state.frame };
+	Window* top = state.stack.back();
+	for (Layer* layer : top->children) {
+		if (layer->menu)
+			drawMenu(layer->menu, &ctx);
+		else if (layer->update_proc)
+			layer->update_proc(layer, &ctx);
+	}
+}
+
+void deliverOutbox() {
+	for (int i = 0; state.outboxPending && !state.outboxHeld && i < SETTLE_LIMIT; ++i) {
+		state.outboxPending = false;
+		DictionaryIterator iter;
+		dict_read_begin_from_buffer(&iter, state.outbox.data(), state.outboxMessageSize);
+		bool acked = state.connected && state.phone && state.phone(&iter);
+		dict_read_begin_from_buffer(&iter, state.outbox.data(), state.outboxMessageSize);
+		++state.stats.wakeups;
+		if (acked) {
+			if (state.outboxSent)
+				state.outboxSent(&iter, state.messageContext);
+		}
+		else if (state.outboxFailed) {
+			state.outboxFailed(&iter, state.connected ? APP_MSG_SEND_REJECTED : APP_MSG_NOT_CONNECTED, state.messageContext);
+		}
+	}
+}
+
+void settle() {
+	deliverOutbox();
+	render();
+}
+
+void configureClicks(Window* window) {
+	memset(window->single, 0, sizeof(window->single));
+	memset(window->longDown, 0, sizeof(window->longDown));
+	memset(window->multi, 0, sizeof(window->multi));
+	if (window->clickConfig) {
+		state.configuring = window;
+		window->clickConfig(window);
+		state.configuring = NULL;
+	}
+}
+
+void loadWindow(Window* window) {
+	if (!window->loaded) {
+		window->loaded = true;
+		if (window->handlers.load)
+			window->handlers.load(window);
+	}
+	if (window->handlers.appear)
+		window->handlers.appear(window);
+	configureClicks(window);
+	state.dirty = true;
+}
+
+void unloadWindow(Window* window) {
+	if (window->handlers.disappear)
+		window->handlers.disappear(window);
+	if (window->loaded) {
+		window->loaded = false;
+		if (window->handlers.unload)
+			window->handlers.unload(window);
+	}
+}
+
+uint64_t nextTick() {
+	if (!state.tickHandler || !state.tickUnits)
+		return UINT64_MAX;
+	uint64_t s = state.nowMs / 1000;
+	uint64_t step = 86400;
+	if (state.tickUnits & SECOND_UNIT)
+		step = 1;
+	else if (state.tickUnits & MINUTE_UNIT)
+		step = 60;
+	else if (state.tickUnits & HOUR_UNIT)
+		step = 3600;
+	uint64_t next = s / step * step * 1000;
+	if (next < state.nowMs || next <= state.lastTickMs)
+		next += step * 1000;
+	return next;
+}
+
+AppTimer* nextTimer() {
+	AppTimer* next = NULL;
+	for (AppTimer* t : state.timers) {
+		if (!next || t->deadline < next->deadline || (t->deadline == next->deadline && t->order < next->order))
+			next = t;
+	}
+	return next;
+}
+
+void fireTick() {
+	time_t t = state.nowMs / 1000;
+	time_t previous = t - 1;
+	struct tm before = *localtime(&previous);
+	struct tm now = *localtime(&t);
+	int units = SECOND_UNIT;
+	if (now.tm_min != before.tm_min)
+		units |= MINUTE_UNIT;
+	if (now.tm_hour != before.tm_hour)
+		units |= HOUR_UNIT;
+	if (now.tm_mday != before.tm_mday)
+		units |= DAY_UNIT;
+	if (now.tm_mon != before.tm_mon)
+		units |= MONTH_UNIT;
+	if (now.tm_year != before.tm_year)
+		units |= YEAR_UNIT;
+	state.lastTickMs = state.nowMs;
+	if (units & state.tickUnits) {
+		++state.stats.wakeups;
+		++state.stats.ticks;
+		state.tickHandler(&now, (TimeUnits)units);
+		settle();
+	}
+}
+
+void fireTimer(AppTimer* timer) {
+	state.timers.erase(find(state.timers.begin(), state.timers.end(), timer));
+	++state.stats.wakeups;
+	++state.stats.timers;
+	timer->callback(timer->data);
+	delete timer;
+	settle();
+}
+
+Tuple* nextTuple(Tuple* tuple) {
+	return (Tuple*)((uint8_t*)tuple + TUPLE_HEADER_SIZE + tuple->length);
+}
+
+DictionaryResult writeTuple(DictionaryIterator* iter, uint32_t key, TupleType type, const void* data, uint16_t size) {
+	if (!iter || !iter->dictionary)
+		return DICT_INVALID_ARGS;
+	if ((uint8_t*)iter->cursor + TUPLE_HEADER_SIZE + size > (uint8_t*)iter->end)
+		return DICT_NOT_ENOUGH_STORAGE;
+	Tuple* tuple = iter->cursor;
+	tuple->key = key;
+	tuple->type = type;
+	tuple->length = size;
+	memcpy(tuple->value, data, size);
+	++iter->dictionary->count;
+	iter->cursor = nextTuple(tuple);
+	return DICT_OK;
+}
+
+}
+
+namespace host {
+
+void reset(time_t start) {
+	for (AppTimer* t : state.timers)
+		delete t;
+	state = State();
+	state.nowMs = (uint64_t)start * 1000;
+	setenv("TZ", "UTC", 1);
+	tzset();
+}
+
+void terminate() {
+	State fresh;
+	for (AppTimer* t : state.timers)
+		delete t;
+	fresh.nowMs = state.nowMs;
+	fresh.stats = state.stats;
+	fresh.logging = state.logging;
+	fresh.persist.swap(state.persist);
+	fresh.connected = state.connected;
+	fresh.outboxSizeMaximum = state.outboxSizeMaximum;
+	fresh.phone = state.phone;
+	fresh.vibes.swap(state.vibes);
+	state = fresh;
+}
+
+const Stats& stats() {
+	return state.stats;
+}
+
+void resetStats() {
+	state.stats = Stats();
+}
+
+void setEventLoop(function<void()> loop) {
+	state.loop = loop;
+}
+
+bool running() {
+	return !state.stack.empty();
+}
+
+time_t now() {
+	return state.nowMs / 1000;
+}
+
+uint64_t nowMs() {
+	return state.nowMs;
+}
+
+void advance(int seconds) {
+	advanceMs((uint64_t)seconds * 1000);
+}
+
+void advanceMs(uint64_t ms) {
+	uint64_t target = state.nowMs + ms;
+	while (true) {
+		uint64_t tick = nextTick();
+		AppTimer* timer = nextTimer();
+		uint64_t next = min(tick, timer ? timer->deadline : UINT64_MAX);
+		if (next > target)
+			break;
+		state.nowMs = next;
+		if (timer && timer->deadline == next)
+			fireTimer(timer);
+		else
+			fireTick();
+	}
+	state.nowMs = target;
+}
+
+void click(ButtonId button) {
+	if (state.stack.empty())
+		return;
+	Window* window = state.stack.back();
+	++state.stats.wakeups;
+	++state.stats.clicks;
+	MultiClick const& multi = window->multi[button];
+	bool repeated = state.clickWindow == window && state.clickButton == button &&
+		state.nowMs - state.clickMs <= (multi.timeout ? multi.timeout : MULTI_CLICK_TIMEOUT_MS);
+	state.clickCount = repeated ? state.clickCount + 1 : 1;
+	state.clickWindow = window;
+	state.clickButton = button;
+	state.clickMs = state.nowMs;
+	if (window->single[button])
+		window->single[button](NULL, window);
+	else if (button == BUTTON_ID_BACK && !multi.handler)
+		window_stack_pop(true);
+	if (multi.handler && state.clickCount >= multi.minClicks && state.clickCount <= multi.maxClicks &&
+			(!multi.lastClickOnly || state.clickCount == multi.maxClicks)) {
+		if (state.clickCount == multi.maxClicks)
+			state.clickCount = 0;
+		multi.handler(NULL, window);
+	}
+	settle();
+}
+
+void longClick(ButtonId button) {
+	if (state.stack.empty())
+		return;
+	Window* window = state.stack.back();
+	++state.stats.wakeups;
+	++state.stats.clicks;
+	if (window->longDown[button])
+		window->longDown[button](NULL, window);
+	else if (window->single[button])
+		window->single[button](NULL, window);
+	settle();
+}
+
+void setConnected(bool connected) {
+	state.connected = connected;
+	if (state.bluetoothHandler) {
+		++state.stats.wakeups;
+		state.bluetoothHandler(connected);
+		settle();
+	}
+}
+
+void setPhone(function<bool(DictionaryIterator*)> phone) {
+	state.phone = phone;
+}
+
+void holdOutbox(bool held) {
+	state.outboxHeld = held;
+	settle();
+}
+
+void setOutboxSizeMaximum(uint32_t size) {
+	state.outboxSizeMaximum = size;
+}
+
+AppMessageResult sendToWatch(const uint8_t* buffer, uint16_t size) {
+	if (!state.connected)
+		return APP_MSG_NOT_CONNECTED;
+	if (!state.messageOpen || !state.inboxReceived)
+		return APP_MSG_APP_NOT_RUNNING;
+	++state.stats.wakeups;
+	if (size > state.inboxSize) {
+		if (state.inboxDropped)
+			state.inboxDropped(APP_MSG_BUFFER_OVERFLOW, state.messageContext);
+		settle();
+		return APP_MSG_BUFFER_OVERFLOW;
+	}
+	++state.stats.messagesIn;
+	state.stats.bytesIn += size;
+	vector<uint8_t> copy(buffer, buffer + size);
+	DictionaryIterator iter;
+	dict_read_begin_from_buffer(&iter, copy.data(), size);
+	state.inboxReceived(&iter, state.messageContext);
+	settle();
+	return APP_MSG_OK;
+}
+
+bool persistHas(uint32_t key) {
+	return state.persist.count(key) > 0;
+}
+
+vector<uint8_t> persistGet(uint32_t key) {
+	auto it = state.persist.find(key);
+	return it != state.persist.end() ? it->second : vector<uint8_t>();
+}
+
+void persistSet(uint32_t key, const vector<uint8_t>& value) {
+	state.persist[key] = value;
+}
+
+int persistUsed() {
+	return ::persistUsed();
+}
+
+void powerLoss() {
+	state.powerLost = true;
+}
+
+const vector<string>& frame() {
+	return state.frame;
+}
+
+vector<uint32_t> vibes() {
+	return state.vibes;
+}
+
+void setLogging(bool enabled) {
+	state.logging = enabled;
+}
+
+}
+
+extern "C" {
+
+time_t time(time_t* tloc) throw() {
+	time_t t = state.nowMs / 1000;
+	if (tloc)
+		*tloc = t;
+	return t;
+}
+
+// The heap of the whole host process, shim included; the sanitizers keep their own allocator.
+size_t heap_bytes_used(void) {
+#if defined(__SANITIZE_ADDRESS__)
+	return __sanitizer_get_current_allocated_bytes();
+#elif defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+	return mallinfo2().uordblks;
+#else
+	return 0;
+#endif
+}
+
+uint16_t time_ms(time_t* tloc, uint16_t* out_ms) {
+	uint16_t ms = state.nowMs % 1000;
+	if (tloc)
+		*tloc = state.nowMs / 1000;
+	if (out_ms)
+		*out_ms = ms;
+	return ms;
+}
+
+time_t time_start_of_today(void) {
+	time_t t = state.nowMs / 1000;
+	struct tm today = *localtime(&t);
+	today.tm_hour = today.tm_min = today.tm_sec = 0;
+	return mktime(&today);
+}
+
+void app_log(uint8_t log_level, const char* src_filename, int src_line_number, const char* fmt, ...) {
+	++state.stats.logs;
+	if (!state.logging)
+		return;
+	fprintf(stderr, "[%d] %s:%d ", log_level, src_filename, src_line_number);
+	va_list args;
+	va_start(args, fmt);
+	vfprintf(stderr, fmt, args);
+	va_end(args);
+	fputc('\n', stderr);
+}
+
+void tick_timer_service_subscribe(TimeUnits tick_units, TickHandler handler) {
+	state.tickUnits = tick_units;
+	state.tickHandler = handler;
+	state.lastTickMs = state.nowMs;
+}
+
+void tick_timer_service_unsubscribe(void) {
+	state.tickUnits = (TimeUnits)0;
+	state.tickHandler = NULL;
+}
+
+AppTimer* app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void* callback_data) {
+	AppTimer* timer = new AppTimer { state.nowMs + timeout_ms, state.timerOrder++, callback, callback_data };
+	state.timers.push_back(timer);
+	return timer;
+}
+
+bool app_timer_reschedule(AppTimer* timer_handle, uint32_t new_timeout_ms) {
+	if (find(state.timers.begin(), state.timers.end(), timer_handle) == state.timers.end())
+		return false;
+	timer_handle->deadline = state.nowMs + new_timeout_ms;
+	timer_handle->order = state.timerOrder++;
+	return true;
+}
+
+void app_timer_cancel(AppTimer* timer_handle) {
+	auto it = find(state.timers.begin(), state.timers.end(), timer_handle);
+	if (it != state.timers.end()) {
+		state.timers.erase(it);
+		delete timer_handle;
+	}
+}
+
+bool persist_exists(const uint32_t key) {
+	return state.persist.count(key) > 0;
+}
+
+int persist_get_size(const uint32_t key) {
+	auto it = state.persist.find(key);
+	return it != state.persist.end() ? (int)it->second.size() : E_DOES_NOT_EXIST;
+}
+
+bool persist_read_bool(const uint32_t key) {
+	return persist_read_int(key) != 0;
+}
+
+int32_t persist_read_int(const uint32_t key) {
+	int32_t value = 0;
+	auto it = state.persist.find(key);
+	++state.stats.persistReads;
+	if (it != state.persist.end())
+		memcpy(&value, it->second.data(), min(sizeof(value), it->second.size()));
+	return value;
+}
+
+int persist_read_data(const uint32_t key, void* buffer, const size_t buffer_size) {
+	auto it = state.persist.find(key);
+	++state.stats.persistReads;
+	if (it == state.persist.end())
+		return E_DOES_NOT_EXIST;
+	size_t size = min(buffer_size, it->second.size());
+	memcpy(buffer, it->second.data(), size);
+	return size;
+}
+
+int persist_read_string(const uint32_t key, char* buffer, const size_t buffer_size) {
+	int size = persist_read_data(key, buffer, buffer_size);
+	if (size > 0)
+		buffer[size - 1] = '\0';
+	return size;
+}
+
+status_t persist_write_bool(const uint32_t key, const bool value) {
+	return persist_write_int(key, value);
+}
+
+status_t persist_write_int(const uint32_t key, const int32_t value) {
+	int written = persist_write_data(key, &value, sizeof(value));
+	return written < 0 ? written : S_SUCCESS;
+}
+
+int persist_write_data(const uint32_t key, const void* data, const size_t size) {
+	size_t length = min(size, (size_t)PERSIST_DATA_MAX_LENGTH);
+	auto it = state.persist.find(key);
+	int previous = it != state.persist.end() ? it->second.size() : 0;
+	if (persistUsed() - previous + (int)length > PERSIST_STORAGE_SIZE)
+		return E_OUT_OF_STORAGE;
+	if (state.powerLost)
+		return length;
+	++state.stats.persistWrites;
+	state.stats.persistBytesWritten += length;
+	state.persist[key].assign((const uint8_t*)data, (const uint8_t*)data + length);
+	return length;
+}
+
+int persist_write_string(const uint32_t key, const char* cstring) {
+	return persist_write_data(key, cstring, strlen(cstring) + 1);
+}
+
+status_t persist_delete(const uint32_t key) {
+	if (state.powerLost)
+		return S_SUCCESS;
+	return state.persist.erase(key) ? S_SUCCESS : E_DOES_NOT_EXIST;
+}
+
+uint32_t dict_calc_buffer_size(const uint8_t tuple_count, ...) {
+	uint32_t size = sizeof(Dictionary) + tuple_count * TUPLE_HEADER_SIZE;
+	va_list args;
+	va_start(args, tuple_count);
+	for (int i = 0; i < tuple_count; ++i)
+		size += va_arg(args, uint32_t);
+	va_end(args);
+	return size;
+}
+
+DictionaryResult dict_write_begin(DictionaryIterator* iter, uint8_t* const buffer, const uint16_t size) {
+	if (!iter || !buffer || size < sizeof(Dictionary))
+		return DICT_INVALID_ARGS;
+	iter->dictionary = (Dictionary*)buffer;
+	iter->dictionary->count = 0;
+	iter->cursor = iter->dictionary->head;
+	iter->end = buffer + size;
+	return DICT_OK;
+}
+
+DictionaryResult dict_write_data(DictionaryIterator* iter, const uint32_t key, const uint8_t* const data, const uint16_t size) {
+	return writeTuple(iter, key, TUPLE_BYTE_ARRAY, data, size);
+}
+
+DictionaryResult dict_write_cstring(DictionaryIterator* iter, const uint32_t key, const char* const cstring) {
+	return writeTuple(iter, key, TUPLE_CSTRING, cstring, cstring ? strlen(cstring) + 1 : 0);
+}
+
+DictionaryResult dict_write_int(DictionaryIterator* iter, const uint32_t key, const void* integer, const uint8_t width_bytes, const bool is_signed) {
+	if (width_bytes != 1 && width_bytes != 2 && width_bytes != 4)
+		return DICT_INVALID_ARGS;
+	return writeTuple(iter, key, is_signed ? TUPLE_INT : TUPLE_UINT, integer, width_bytes);
+}
+
+DictionaryResult dict_write_uint8(DictionaryIterator* iter, const uint32_t key, const uint8_t value) {
+	return dict_write_int(iter, key, &value, sizeof(value), false);
+}
+
+DictionaryResult dict_write_uint16(DictionaryIterator* iter, const uint32_t key, const uint16_t value) {
+	return dict_write_int(iter, key, &value, sizeof(value), false);
+}
+
+DictionaryResult dict_write_uint32(DictionaryIterator* iter, const uint32_t key, const uint32_t value) {
+	return dict_write_int(iter, key, &value, sizeof(value), false);
+}
+
+DictionaryResult dict_write_int8(DictionaryIterator* iter, const uint32_t key, const int8_t value) {
+	return dict_write_int(iter, key, &value, sizeof(value), true);
+}
+
+DictionaryResult dict_write_int16(DictionaryIterator* iter, const uint32_t key, const int16_t value) {
+	return dict_write_int(iter, key, &value, sizeof(value), true);
+}
+
+DictionaryResult dict_write_int32(DictionaryIterator* iter, const uint32_t key, const int32_t value) {
+	return dict_write_int(iter, key, &value, sizeof(value), true);
+}
+
+uint32_t dict_write_end(DictionaryIterator* iter) {
+	if (!iter || !iter->dictionary)
+		return 0;
+	iter->end = iter->cursor;
+	iter->cursor = iter->dictionary->head;
+	return (uint8_t*)iter->end - (uint8_t*)iter->dictionary;
+}
+
+Tuple* dict_read_begin_from_buffer(DictionaryIterator* iter, const uint8_t* const buffer, const uint16_t size) {
+	if (!iter || !buffer || size < sizeof(Dictionary))
+		return NULL;
+	iter->dictionary = (Dictionary*)buffer;
+	iter->end = buffer + size;
+	iter->cursor = iter->dictionary->head;
+	return dict_read_first(iter);
+}
+
+Tuple* dict_read_next(DictionaryIterator* iter) {
+	if ((uint8_t*)iter->cursor + TUPLE_HEADER_SIZE > (uint8_t*)iter->end)
+		return NULL;
+	Tuple* tuple = iter->cursor;
+	if ((uint8_t*)nextTuple(tuple) > (uint8_t*)iter->end)
+		return NULL;
+	iter->cursor = nextTuple(tuple);
+	return tuple;
+}
+
+Tuple* dict_read_first(DictionaryIterator* iter) {
+	iter->cursor = iter->dictionary->head;
+	return dict_read_next(iter);
+}
+
+Tuple* dict_find(const DictionaryIterator* iter, const uint32_t key) {
+	DictionaryIterator i = *iter;
+	for (Tuple* tuple = dict_read_first(&i); tuple; tuple = dict_read_next(&i)) {
+		if (tuple->key == key)
+			return tuple;
+	}
+	return NULL;
+}
+
+AppMessageResult app_message_open(const uint32_t size_inbound, const uint32_t size_outbound) {
+	if (state.messageOpen)
+		return APP_MSG_INVALID_STATE;
+	state.messageOpen = true;
+	state.inboxSize = min(size_inbound, INBOX_SIZE_MAXIMUM);
+	state.outbox.assign(min(size_outbound, state.outboxSizeMaximum), 0);
+	return APP_MSG_OK;
+}
+
+void app_message_deregister_callbacks(void) {
+	state.inboxReceived = NULL;
+	state.inboxDropped = NULL;
+	state.outboxSent = NULL;
+	state.outboxFailed = NULL;
+}
+
+void* app_message_get_context(void) {
+	return state.messageContext;
+}
+
+void* app_message_set_context(void* context) {
+	void* previous = state.messageContext;
+	state.messageContext = context;
+	return previous;
+}
+
+AppMessageInboxReceived app_message_register_inbox_received(AppMessageInboxReceived received_callback) {
+	AppMessageInboxReceived previous = state.inboxReceived;
+	state.inboxReceived = received_callback;
+	return previous;
+}
+
+AppMessageInboxDropped app_message_register_inbox_dropped(AppMessageInboxDropped dropped_callback) {
+	AppMessageInboxDropped previous = state.inboxDropped;
+	state.inboxDropped = dropped_callback;
+	return previous;
+}
+
+AppMessageOutboxSent app_message_register_outbox_sent(AppMessageOutboxSent sent_callback) {
+	AppMessageOutboxSent previous = state.outboxSent;
+	state.outboxSent = sent_callback;
+	return previous;
+}
+
+AppMessageOutboxFailed app_message_register_outbox_failed(AppMessageOutboxFailed failed_callback) {
+	AppMessageOutboxFailed previous = state.outboxFailed;
+	state.outboxFailed = failed_callback;
+	return previous;
+}
+
+uint32_t app_message_inbox_size_maximum(void) {
+	return INBOX_SIZE_MAXIMUM;
+}
+
+uint32_t app_message_outbox_size_maximum(void) {
+	return state.outboxSizeMaximum;
+}
+
+AppMessageResult app_message_outbox_begin(DictionaryIterator** iterator) {
+	if (!state.messageOpen)
+		return APP_MSG_INVALID_STATE;
+	if (state.outboxOpen || state.outboxPending)
+		return APP_MSG_BUSY;
+	state.outboxOpen = true;
+	dict_write_begin(&state.outboxIterator, state.outbox.data(), state.outbox.size());
+	*iterator = &state.outboxIterator;
+	return APP_MSG_OK;
+}
+
+AppMessageResult app_message_outbox_send(void) {
+	if (!state.outboxOpen)
+		return APP_MSG_INVALID_STATE;
+	state.outboxOpen = false;
+	uint32_t size = dict_write_end(&state.outboxIterator);
+	state.outbox.resize(max((size_t)size, state.outbox.size()));
+	state.outboxMessageSize = size;
+	++state.stats.messagesOut;
+	state.stats.bytesOut += size;
+	state.outboxPending = true;
+	return APP_MSG_OK;
+}
+
+bool bluetooth_connection_service_peek(void) {
+	return state.connected;
+}
+
+void bluetooth_connection_service_subscribe(BluetoothConnectionHandler handler) {
+	state.bluetoothHandler = handler;
+}
+
+void bluetooth_connection_service_unsubscribe(void) {
+	state.bluetoothHandler = NULL;
+}
+
+void vibes_cancel(void) {
+}
+
+void vibes_short_pulse(void) {
+	++state.stats.vibes;
+	state.vibes.push_back(1);
+}
+
+void vibes_long_pulse(void) {
+	++state.stats.vibes;
+	state.vibes.push_back(1);
+}
+
+void vibes_double_pulse(void) {
+	++state.stats.vibes;
+	state.vibes.push_back(2);
+}
+
+void vibes_enqueue_custom_pattern(VibePattern pattern) {
+	++state.stats.vibes;
+	state.vibes.push_back(pattern.num_segments);
+}
+
+GFont fonts_get_system_font(const char* font_key) {
+	for (FontInfo& font : fonts) {
+		if (strcmp(font.key, font_key) == 0)
+			return &font;
+	}
+	return &fonts[0];
+}
+
+void graphics_context_set_stroke_color(GContext*, GColor) {
+}
+
+void graphics_context_set_fill_color(GContext*, GColor) {
+}
+
+void graphics_context_set_text_color(GContext*, GColor) {
+}
+
+void graphics_context_set_stroke_width(GContext*, uint8_t) {
+}
+
+void graphics_context_set_antialiased(GContext*, bool) {
+}
+
+void graphics_fill_rect(GContext*, GRect, uint16_t, GCornerMask) {
+}
+
+void graphics_draw_line(GContext*, GPoint, GPoint) {
+}
+
+void graphics_draw_text(GContext* ctx, const char* text, GFont const, const GRect, const GTextOverflowMode,
+			const GTextAlignment, GTextAttributes*) {
+	ctx->texts->push_back(text);
+}
+
+Layer* layer_create(GRect frame) {
+	return new Layer { frame, NULL, NULL, NULL };
+}
+
+void layer_destroy(Layer* layer) {
+	layer_remove_from_parent(layer);
+	delete layer;
+}
+
+void layer_mark_dirty(Layer*) {
+	state.dirty = true;
+}
+
+void layer_set_update_proc(Layer* layer, LayerUpdateProc update_proc) {
+	layer->update_proc = update_proc;
+}
+
+GRect layer_get_bounds(const Layer* layer) {
+	return GRect(0, 0, layer->frame.size.w, layer->frame.size.h);
+}
+
+void layer_add_child(Layer* parent, Layer* child) {
+	Window* window = parent->window;
+	if (window && &window->root == parent) {
+		layer_remove_from_parent(child);
+		window->children.push_back(child);
+		child->window = window;
+	}
+	state.dirty = true;
+}
+
+void layer_remove_from_parent(Layer* child) {
+	Window* window = child->window;
+	if (window) {
+		auto it = find(window->children.begin(), window->children.end(), child);
+		if (it != window->children.end())
+			window->children.erase(it);
+		child->window = NULL;
+	}
+	state.dirty = true;
+}
+
+Window* window_create(void) {
+	Window* window = new Window();
+	window->root.frame = GRect(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+	window->root.window = window;
+	return window;
+}
+
+void window_destroy(Window* window) {
+	window_stack_remove(window, false);
+	for (Layer* child : window->children)
+		child->window = NULL;
+	delete window;
+}
+
+void window_set_click_config_provider(Window* window, ClickConfigProvider click_config_provider) {
+	window->clickConfig = click_config_provider;
+	// Like the OS, a provider set on the window in front takes effect right away.
+	if (!state.stack.empty() && state.stack.back() == window)
+		configureClicks(window);
+}
+
+void window_set_window_handlers(Window* window, WindowHandlers handlers) {
+	window->handlers = handlers;
+}
+
+Layer* window_get_root_layer(const Window* window) {
+	return const_cast<Layer*>(&window->root);
+}
+
+void window_single_click_subscribe(ButtonId button_id, ClickHandler handler) {
+	if (state.configuring)
+		state.configuring->single[button_id] = handler;
+}
+
+void window_long_click_subscribe(ButtonId button_id, uint16_t, ClickHandler down_handler, ClickHandler) {
+	if (state.configuring)
+		state.configuring->longDown[button_id] = down_handler;
+}
+
+void window_multi_click_subscribe(ButtonId button_id, uint8_t min_clicks, uint8_t max_clicks, uint16_t timeout, bool last_click_only, ClickHandler handler) {
+	if (state.configuring) {
+		MultiClick multi = { handler, max<uint8_t>(min_clicks, 2), max_clicks ? max_clicks : min_clicks, timeout, last_click_only };
+		state.configuring->multi[button_id] = multi;
+	}
+}
+
+void window_stack_push(Window* window, bool) {
+	state.stack.push_back(window);
+	loadWindow(window);
+}
+
+Window* window_stack_pop(bool) {
+	if (state.stack.empty())
+		return NULL;
+	Window* window = state.stack.back();
+	state.stack.pop_back();
+	unloadWindow(window);
+	if (!state.stack.empty())
+		loadWindow(state.stack.back());
+	return window;
+}
+
+void window_stack_pop_all(const bool) {
+	while (!state.stack.empty()) {
+		Window* window = state.stack.back();
+		state.stack.pop_back();
+		unloadWindow(window);
+	}
+}
+
+bool window_stack_remove(Window* window, bool animated) {
+	auto it = find(state.stack.begin(), state.stack.end(), window);
+	if (it == state.stack.end())
+		return false;
+	if (window == state.stack.back()) {
+		window_stack_pop(animated);
+		return true;
+	}
+	state.stack.erase(it);
+	unloadWindow(window);
+	return true;
+}
+
+MenuLayer* menu_layer_create(GRect frame) {
+	MenuLayer* menu = new MenuLayer();
+	menu->layer.frame = frame;
+	menu->layer.menu = menu;
+	menu->reload = true;
+	state.menus.push_back(menu);
+	return menu;
+}
+
+void menu_layer_destroy(MenuLayer* menu_layer) {
+	layer_remove_from_parent(&menu_layer->layer);
+	state.menus.erase(find(state.menus.begin(), state.menus.end(), menu_layer));
+	delete menu_layer;
+}
+
+Layer* menu_layer_get_layer(const MenuLayer* menu_layer) {
+	return const_cast<Layer*>(&menu_layer->layer);
+}
+
+void menu_layer_set_callbacks(MenuLayer* menu_layer, void* callback_context, MenuLayerCallbacks callbacks) {
+	menu_layer->context = callback_context;
+	menu_layer->callbacks = callbacks;
+	menu_layer->reload = true;
+	state.dirty = true;
+}
+
+void menu_layer_reload_data(MenuLayer* menu_layer) {
+	++state.stats.reloads;
+	menu_layer->reload = true;
+	state.dirty = true;
+}
+
+void menu_layer_set_selected_index(MenuLayer* menu_layer, MenuIndex index, MenuRowAlign, bool) {
+	layoutMenu(menu_layer, true);
+	if (menu_layer->heights.empty())
+		return;
+	menu_layer->selected.row = min<int>(index.row, menu_layer->heights.size() - 1);
+	scrollToSelected(menu_layer);
+	state.dirty = true;
+}
+
+MenuIndex menu_layer_get_selected_index(const MenuLayer* menu_layer) {
+	return menu_layer->selected;
+}
+
+void app_event_loop(void) {
+	settle();
+	if (state.loop)
+		state.loop();
+}
+
+}
@@ -0,0 +1,334 @@
+#include "tracker_data.hpp"
+#include "host.hpp"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+int app_main(void);
+TrackingList const* getTrackingList();
+
+// Drives the real app through a trace of button presses, launches and connection changes on the
+// host's virtual clock, checking the model after every event and counting what the run cost.
+//
+//   tracker_sim [--trace FILE | --week | --random N] [--seed N] [--record FILE] [--allocations]
+//
+// A trace has one event per line: the seconds to wait before it and its action, one of launch,
+// exit, up, down, select, back, long-up, long-down, long-select, connect and disconnect. --week
+// generates a work week of slot switches with the odd edit, merge, split and relaunch; --random
+// generates N events of any kind. --record writes the trace that ran, so a failing run can be replayed.
+// --allocations, in a build with TRACKER_PROFILE_ALLOCATIONS, reports the allocation profile at
+// the end and fails the run on blocks the app left live and on double frees.
+
+static const time_t MONDAY_MORNING = 1767600000; // 2026-01-05 08:00 UTC
+static const int HOUR = 60 * 60;
+static const int DAY = 24 * HOUR;
+
+enum Action { LAUNCH, EXIT, UP, DOWN, SELECT, BACK, LONG_UP, LONG_DOWN, LONG_SELECT, CONNECT, DISCONNECT };
+
+static char const* const ACTION_NAMES[] = {
+	"launch", "exit", "up", "down", "select", "back", "long-up", "long-down", "long-select", "connect", "disconnect"
+};
+
+struct Event {
+	int delay;
+	Action action;
+};
+
+// xorshift, so that a seed gives the same trace on every platform.
+static uint32_t seed = 1;
+
+static uint32_t nextRandom(uint32_t bound) {
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed % bound;
+}
+
+static vector<Event> events;
+static size_t nextEvent;
+static int checks;
+static int violations;
+
+static void add(int delay, Action action) {
+	Event event = { delay, action };
+	events.push_back(event);
+}
+
+static void addSelect(int row) {
+	for (int i = 0; i <= row; ++i)
+		add(0, DOWN);
+}
+
+// Every step of a day starts and ends in normal mode with nothing selected; down and back get
+// there from any selection. Mornings reset the day's total and the app stays open until the
+// evening. In between the active slot moves every quarter to one and a half hours, with the odd
+// time edit, merge, split, or exit and relaunch.
+static void generateWeek() {
+	int wait = 0;
+	for (int day = 0; day < 5; ++day) {
+		add(wait, LAUNCH);
+		add(0, DOWN);
+		add(0, BACK);
+		add(0, LONG_SELECT);
+		int elapsed = 0;
+		while (elapsed < 9 * HOUR) {
+			int step = (15 + nextRandom(76)) * 60;
+			uint32_t kind = nextRandom(20);
+			if (kind < 14) {
+				addSelect(nextRandom(6));
+				add(0, SELECT);
+				add(0, BACK);
+			}
+			else if (kind < 16) {
+				addSelect(nextRandom(6));
+				add(0, LONG_SELECT);
+				for (uint32_t i = 1 + nextRandom(5), up = nextRandom(2); i > 0; --i)
+					add(1, up ? UP : DOWN);
+				add(0, SELECT);
+				add(0, SELECT);
+				add(0, SELECT);
+				add(0, BACK);
+			}
+			else if (kind < 17) {
+				add(0, SELECT);
+				add(0, LONG_UP);
+				add(0, SELECT);
+				add(5, BACK);
+			}
+			else if (kind < 19) {
+				add(0, SELECT);
+				addSelect(nextRandom(6));
+				add(0, LONG_SELECT);
+				add(0, BACK);
+				add(0, SELECT);
+				add(5, BACK);
+			}
+			else {
+				add(0, BACK);
+				add(60 + nextRandom(5 * 60), LAUNCH);
+				add(0, DOWN);
+				add(0, BACK);
+			}
+			add(step, DOWN);
+			add(0, BACK);
+			elapsed += step;
+		}
+		add(0, EXIT);
+		wait = DAY - elapsed;
+	}
+}
+
+// Any button at any time, so back exits now and then and the next launch opens the app again.
+static void generateRandom(int count) {
+	add(0, LAUNCH);
+	for (int i = 0; i < count; ++i) {
+		int delay = nextRandom(4) == 0 ? nextRandom(2 * HOUR) : nextRandom(5);
+		Action action = (Action)(nextRandom(20) == 0 ? LAUNCH : 1 + nextRandom(DISCONNECT));
+		add(delay, action);
+	}
+}
+
+static bool load(char const* path) {
+	FILE* in = fopen(path, "r");
+	if (!in)
+		return false;
+	char line[128], name[32];
+	int delay;
+	while (fgets(line, sizeof(line), in)) {
+		if (line[0] == '#' || sscanf(line, "%d %31s", &delay, name) != 2)
+			continue;
+		int action = 0;
+		while (action <= DISCONNECT && strcmp(name, ACTION_NAMES[action]) != 0)
+			++action;
+		if (action > DISCONNECT) {
+			fprintf(stderr, "unknown action %s\n", name);
+			fclose(in);
+			return false;
+		}
+		add(delay, (Action)action);
+	}
+	fclose(in);
+	return true;
+}
+
+static bool save(char const* path) {
+	FILE* out = fopen(path, "w");
+	if (!out)
+		return false;
+	fprintf(out, "# seconds action\n");
+	for (Event const& event : events)
+		fprintf(out, "%d %s\n", event.delay, ACTION_NAMES[event.action]);
+	fclose(out);
+	return true;
+}
+
+static void violation(char const* what, int value) {
+	if (violations++ < 10)
+		fprintf(stderr, "event %d at %ld: %s (%d)\n", (int)nextEvent, (long)host::now(), what, value);
+}
+
+// The running total has to match the visible rows, no row may go negative, and the rows have to
+// cover every leaf exactly once.
+static void check() {
+	TrackingList const* list = getTrackingList();
+	if (!list)
+		return;
+	++checks;
+	if (!list->totalsConsistent())
+		violation("running total differs from the rows", list->totalTime(false));
+	int height = 0;
+	for (size_t i = 0; i < list->size(); ++i) {
+		if (list->at(i)->getTime() < 0)
+			violation("negative row time", list->at(i)->getTime());
+		height += list->at(i)->getHeight();
+	}
+	if (height != list->totalHeight())
+		violation("rows do not cover the leaves", height);
+	if (list->totalTime() < list->totalTime(false))
+		violation("negative accumulated time", list->totalTime() - list->totalTime(false));
+}
+
+// Runs in place of the event loop until the trace exits the app or launches it again.
+static void runLaunch() {
+	host::advanceMs(0);
+	check();
+	while (nextEvent < events.size() && events[nextEvent].action != LAUNCH) {
+		Event const& event = events[nextEvent++];
+		host::advance(event.delay);
+		switch (event.action) {
+			case LAUNCH:
+				break;
+			case EXIT:
+				return;
+			case UP:
+				host::click(BUTTON_ID_UP);
+				break;
+			case DOWN:
+				host::click(BUTTON_ID_DOWN);
+				break;
+			case SELECT:
+				host::click(BUTTON_ID_SELECT);
+				break;
+			case BACK:
+				host::click(BUTTON_ID_BACK);
+				break;
+			case LONG_UP:
+				host::longClick(BUTTON_ID_UP);
+				break;
+			case LONG_DOWN:
+				host::longClick(BUTTON_ID_DOWN);
+				break;
+			case LONG_SELECT:
+				host::longClick(BUTTON_ID_SELECT);
+				break;
+			case CONNECT:
+				host::setConnected(true);
+				break;
+			case DISCONNECT:
+				host::setConnected(false);
+				break;
+		}
+		if (!host::running())
+			return;
+		check();
+	}
+}
+
+int main(int argc, char** argv) {
+	char const* tracePath = NULL;
+	char const* recordPath = NULL;
+	int randomEvents = 0;
+	bool week = false;
+	bool allocations = false;
+	for (int i = 1; i < argc; ++i) {
+		string option = argv[i];
+		if (option == "--week") {
+			week = true;
+		}
+		else if (option == "--allocations") {
+			allocations = true;
+		}
+		else if (i + 1 < argc && option == "--trace") {
+			tracePath = argv[++i];
+		}
+		else if (i + 1 < argc && option == "--random") {
+			randomEvents = atoi(argv[++i]);
+		}
+		else if (i + 1 < argc && option == "--seed") {
+			seed = std::max(1, atoi(argv[++i]));
+		}
+		else if (i + 1 < argc && option == "--record") {
+			recordPath = argv[++i];
+		}
+		else {
+			fprintf(stderr, "unknown option %s\n", argv[i]);
+			return 2;
+		}
+	}
+#ifndef TRACKER_PROFILE_ALLOCATIONS
+	if (allocations) {
+		fprintf(stderr, "--allocations needs a build with TRACKER_PROFILE_ALLOCATIONS\n");
+		return 2;
+	}
+#endif
+	if (tracePath && !load(tracePath)) {
+		fprintf(stderr, "cannot read %s\n", tracePath);
+		return 2;
+	}
+	if (week)
+		generateWeek();
+	if (randomEvents > 0)
+		generateRandom(randomEvents);
+	if (events.empty())
+		generateWeek();
+	if (recordPath && !save(recordPath)) {
+		fprintf(stderr, "cannot write %s\n", recordPath);
+		return 2;
+	}
+
+	host::reset(MONDAY_MORNING);
+	host::setLogging(false);
+	uint32_t allocationsBefore = allocationCount, bytesBefore = allocatedBytes;
+#ifdef TRACKER_PROFILE_ALLOCATIONS
+	markAllocations();
+#endif
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	int launches = 0;
+	while (nextEvent < events.size()) {
+		Event const& event = events[nextEvent++];
+		host::advance(event.delay);
+		if (event.action == LAUNCH) {
+			++launches;
+			host::setEventLoop(runLaunch);
+			app_main();
+			host::terminate();
+		}
+		else if (event.action == CONNECT || event.action == DISCONNECT) {
+			host::setConnected(event.action == CONNECT);
+		}
+	}
+	double wallMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+	host::Stats const& stats = host::stats();
+	printf("events %d, launches %d, simulated %.1f h in %.1f ms\n", (int)events.size(), launches,
+		(host::now() - MONDAY_MORNING) / (double)HOUR, wallMs);
+	printf("wakeups %d (ticks %d, timers %d, clicks %d)\n", stats.wakeups, stats.ticks, stats.timers, stats.clicks);
+	printf("redraws %d (reloads %d, rows drawn %d)\n", stats.renders, stats.reloads, stats.rowDraws);
+	printf("allocations %u (%u bytes)\n", allocationCount - allocationsBefore, allocatedBytes - bytesBefore);
+	printf("flash writes %d (%d bytes), reads %d\n", stats.persistWrites, stats.persistBytesWritten, stats.persistReads);
+	printf("invariants checked %d times, %d violations\n", checks, violations);
+	int problems = 0;
+#ifdef TRACKER_PROFILE_ALLOCATIONS
+	// Dropping the shim's windows and timers leaves only what the app itself kept.
+	if (allocations) {
+		host::reset();
+		host::setLogging(true);
+		fflush(stdout);
+		problems = reportAllocations();
+	}
+#endif
+	return violations != 0 || problems != 0;
+}
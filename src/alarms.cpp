@@ -0,0 +1,54 @@
+#include "alarms.hpp"
+
+static const int HOUR = 60 * 60;
+
+// Times are those of the list as of now, so a threshold is as far ahead as it is above them.
+void Alarms::plan(TrackingList const& list, int now) {
+	queue.clear();
+	revision = list.getRevision();
+	if (list.getActiveNode() == NULL_V)
+		return;
+	int totalPeriod = list.getTotalHours() * HOUR;
+	int accPeriod = list.getTotalAccHours() * HOUR;
+	add(now, list.at(list.getActiveIndex())->getTime(), HOUR, ALARM_HOUR);
+	add(now, list.totalTime(false), totalPeriod, ALARM_TOTAL);
+	add(now, list.totalTime(), totalPeriod, ALARM_TOTAL);
+	add(now, list.totalTime(), accPeriod, ALARM_ACC_TOTAL);
+	for (Goal const& goal : list.getGoals()) {
+		int time = list.getNodeTime(goal.node);
+		int pattern = goal.pattern >= 0 && goal.pattern < ALARM_PATTERNS ? goal.pattern : ALARM_GOAL;
+		if (time != NULL_V && time < goal.minutes * 60 && list.accruesTo(goal.node)) {
+			Alarm alarm = { now + goal.minutes * 60 - time, 0, (schar)pattern };
+			queue.push(alarm);
+		}
+	}
+}
+
+// Repeats whenever the time reaches the next multiple of the period.
+void Alarms::add(int now, int time, int period, int pattern) {
+	if (period <= 0)
+		return;
+	Alarm alarm = { now + period - time % period, period, (schar)pattern };
+	queue.push(alarm);
+}
+
+void Alarms::clear() {
+	queue.clear();
+	revision = NULL_V;
+}
+
+// Takes every alarm due by now, moving repeating ones to their next time, and returns the
+// strongest pattern among them or NULL_V.
+int Alarms::fire(int now) {
+	int pattern = NULL_V;
+	while (!queue.empty() && queue.top().deadline <= now) {
+		Alarm alarm = queue.top();
+		queue.pop();
+		pattern = max(pattern, (int)alarm.pattern);
+		if (alarm.period > 0) {
+			alarm.deadline += alarm.period;
+			queue.push(alarm);
+		}
+	}
+	return pattern;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "tracker_data.hpp"
+
+// Vibe patterns of the alarms, weakest first. Alarms falling due together vibrate the strongest.
+enum AlarmPattern { ALARM_HOUR, ALARM_GOAL, ALARM_BUDGET, ALARM_TOTAL, ALARM_ACC_TOTAL, ALARM_PATTERNS };
+
+// An absolute time to vibrate at and, for one that repeats, the seconds to the next time.
+struct Alarm {
+	int deadline;
+	int period;
+	schar pattern;
+
+	bool operator<(Alarm const& other) const {
+		return deadline < other.deadline;
+	}
+};
+
+// The thresholds the accruing slot heads for: every hour of the active row, every multiple of the
+// total hours by the day's or accumulated total, every multiple of the accumulated hours by the
+// accumulated total, and the goals of the nodes the slot accrues to. Only accrual moves time
+// without a new revision of the list, so the deadlines are planned again only for a new revision,
+// and the next one is the top of a heap.
+class Alarms {
+public:
+	bool isPlanned(TrackingList const& list) const {
+		return list.getRevision() == revision;
+	}
+	void plan(TrackingList const&, int);
+	void clear();
+
+	// NULL_V when the list does not accrue.
+	int getNextDeadline() const {
+		return queue.empty() ? NULL_V : queue.top().deadline;
+	}
+	int fire(int);
+
+	static const int CAPACITY = 24;
+
+private:
+	void add(int, int, int, int);
+
+	PriorityQueue<Alarm, CAPACITY> queue;
+	int revision = NULL_V;
+};
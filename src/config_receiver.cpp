@@ -0,0 +1,37 @@
+#include "config_receiver.hpp"
+
+// Returns whether the message was a config chunk. Chunks that do not continue the blob are dropped,
+// as are ones with a negative offset, no bytes or data that is not a byte array.
+bool ConfigReceiver::receive(DictionaryIterator* iter) {
+	Tuple* sizeTuple = dict_find(iter, SIZE_KEY);
+	Tuple* offsetTuple = dict_find(iter, OFFSET_KEY);
+	Tuple* dataTuple = dict_find(iter, DATA_KEY);
+	if (!sizeTuple || !offsetTuple || !dataTuple)
+		return false;
+	int total = sizeTuple->value->int32;
+	int offset = offsetTuple->value->int32;
+	int length = dataTuple->length;
+	if (total <= 0 || total > MAX_SIZE) {
+		app_log(APP_LOG_LEVEL_WARNING, __FILE__, __LINE__, "config of %d bytes does not fit", total);
+		reset();
+		return true;
+	}
+	if (offset < 0 || length <= 0 || dataTuple->type != TUPLE_BYTE_ARRAY) {
+		app_log(APP_LOG_LEVEL_WARNING, __FILE__, __LINE__, "malformed config chunk at %d", offset);
+		return true;
+	}
+	if (offset == 0) {
+		size = total;
+		received = 0;
+	}
+	if (total != size || offset > received || offset + length > size)
+		return true;
+	memcpy(data + offset, dataTuple->value->data, length);
+	if (offset + length > received)
+		received = offset + length;
+	return true;
+}
+
+void ConfigReceiver::reset() {
+	size = received = 0;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "pebble.hpp"
+
+// Reassembles the config blob the phone sends in chunks. Every chunk carries the blob size and the
+// offset of its bytes, so one the phone resends after a lost ack lands on the same bytes again and
+// a chunk at offset 0 starts a new blob.
+class ConfigReceiver {
+public:
+	bool receive(DictionaryIterator*);
+	void reset();
+
+	bool isComplete() const {
+		return size > 0 && received == size;
+	}
+	uint8_t const* getData() const {
+		return data;
+	}
+	int getSize() const {
+		return size;
+	}
+
+	static const uint32_t SIZE_KEY = 7000;
+	static const uint32_t OFFSET_KEY = 7001;
+	static const uint32_t DATA_KEY = 7002;
+	static const int CHUNK_SIZE = 64;
+	static const int INBOX_SIZE = 128;
+	static const int MAX_SIZE = PERSIST_DATA_MAX_LENGTH;
+
+private:
+	uint8_t data[MAX_SIZE];
+	int size = 0;
+	int received = 0;
+};
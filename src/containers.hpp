@@ -0,0 +1,241 @@
+#pragma once
+
+#include "pebble.hpp"
+
+// Bounded containers and helpers for the watch binary, which links no C++ runtime. Storage is
+// inline and sized by the template argument, so nothing allocates after construction; adding to a
+// full container fails instead of growing.
+
+template<typename T>
+inline T min(T a, T b) {
+	return b < a ? b : a;
+}
+
+template<typename T>
+inline T max(T a, T b) {
+	return a < b ? b : a;
+}
+
+template<typename T>
+inline void swap(T& a, T& b) {
+	T t = a;
+	a = b;
+	b = t;
+}
+
+// Elements are moved with memmove, so T has to be trivially copyable.
+template<typename T, int N>
+class StaticVector {
+public:
+	int size() const {
+		return count;
+	}
+	bool empty() const {
+		return count == 0;
+	}
+	bool full() const {
+		return count == N;
+	}
+	static int capacity() {
+		return N;
+	}
+	T& operator[](int index) {
+		return items[index];
+	}
+	T const& operator[](int index) const {
+		return items[index];
+	}
+	T* begin() {
+		return items;
+	}
+	T* end() {
+		return items + count;
+	}
+	T const* begin() const {
+		return items;
+	}
+	T const* end() const {
+		return items + count;
+	}
+
+	bool push_back(T const& item) {
+		return insert(count, item);
+	}
+	bool insert(int index, T const& item) {
+		if (count == N)
+			return false;
+		memmove(items + index + 1, items + index, (count - index) * sizeof(T));
+		items[index] = item;
+		++count;
+		return true;
+	}
+	void erase(int index) {
+		memmove(items + index, items + index + 1, (count - index - 1) * sizeof(T));
+		--count;
+	}
+	void clear() {
+		count = 0;
+	}
+
+private:
+	T items[N];
+	int count = 0;
+};
+
+// Keys stay sorted so a lookup is a binary search; inserting an existing key keeps the old value.
+template<typename K, typename V, int N>
+class FlatMap {
+public:
+	struct Entry {
+		K key;
+		V value;
+	};
+
+	int size() const {
+		return entries.size();
+	}
+	bool empty() const {
+		return entries.empty();
+	}
+	Entry const& operator[](int index) const {
+		return entries[index];
+	}
+	Entry const* begin() const {
+		return entries.begin();
+	}
+	Entry const* end() const {
+		return entries.end();
+	}
+
+	V const* find(K const& key) const {
+		int index = lowerBound(key);
+		return index < size() && !(key < entries[index].key) ? &entries[index].value : NULL;
+	}
+	bool insert(K const& key, V const& value) {
+		int index = lowerBound(key);
+		if (index < size() && !(key < entries[index].key))
+			return true;
+		Entry entry = { key, value };
+		return entries.insert(index, entry);
+	}
+	void clear() {
+		entries.clear();
+	}
+
+private:
+	int lowerBound(K const& key) const {
+		int low = 0, high = size();
+		while (low < high) {
+			int middle = (low + high) / 2;
+			if (entries[middle].key < key)
+				low = middle + 1;
+			else
+				high = middle;
+		}
+		return low;
+	}
+
+	StaticVector<Entry, N> entries;
+};
+
+// Keeps the last N items; pushing to a full ring drops the oldest. Index 0 is the oldest item.
+template<typename T, int N>
+class RingBuffer {
+public:
+	int size() const {
+		return count;
+	}
+	bool empty() const {
+		return count == 0;
+	}
+	bool full() const {
+		return count == N;
+	}
+	static int capacity() {
+		return N;
+	}
+	T& operator[](int index) {
+		return items[(first + index) % N];
+	}
+	T const& operator[](int index) const {
+		return items[(first + index) % N];
+	}
+	T& front() {
+		return items[first];
+	}
+	T& back() {
+		return (*this)[count - 1];
+	}
+
+	void push(T const& item) {
+		if (count == N)
+			first = (first + 1) % N;
+		else
+			++count;
+		back() = item;
+	}
+	void pop_front() {
+		first = (first + 1) % N;
+		--count;
+	}
+	void pop_back() {
+		--count;
+	}
+	void clear() {
+		first = count = 0;
+	}
+
+private:
+	T items[N];
+	int first = 0;
+	int count = 0;
+};
+
+// A binary min-heap by operator<: the least item is on top, which is O(1) to look at, while
+// pushing and popping take log N swaps.
+template<typename T, int N>
+class PriorityQueue {
+public:
+	int size() const {
+		return items.size();
+	}
+	bool empty() const {
+		return items.empty();
+	}
+	bool full() const {
+		return items.full();
+	}
+	T const& top() const {
+		return items[0];
+	}
+
+	bool push(T const& item) {
+		if (!items.push_back(item))
+			return false;
+		for (int i = size() - 1; i > 0 && items[i] < items[(i - 1) / 2]; i = (i - 1) / 2)
+			swap(items[i], items[(i - 1) / 2]);
+		return true;
+	}
+	void pop() {
+		items[0] = items[size() - 1];
+		items.erase(size() - 1);
+		for (int i = 0;;) {
+			int least = i;
+			int left = 2 * i + 1;
+			if (left < size() && items[left] < items[least])
+				least = left;
+			if (left + 1 < size() && items[left + 1] < items[least])
+				least = left + 1;
+			if (least == i)
+				break;
+			swap(items[i], items[least]);
+			i = least;
+		}
+	}
+	void clear() {
+		items.clear();
+	}
+
+private:
+	StaticVector<T, N> items;
+};
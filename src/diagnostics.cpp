@@ -0,0 +1,48 @@
+#include "diagnostics.hpp"
+
+Diagnostics diagnostics;
+
+static const int TUPLE_HEADER_SIZE = 7;
+
+static char const* const NAMES[Diagnostics::COUNTERS] = {
+	"ticks", "timers", "full redraws", "partial redraws", "reloads", "draws", "draw ms",
+	"heap", "heap peak", "flash bytes", "bytes in", "bytes out"
+};
+
+char const* Diagnostics::getName(int counter) {
+	return NAMES[counter];
+}
+
+uint32_t Diagnostics::getValue(int counter) const {
+	switch (counter) {
+		case 0: return ticks;
+		case 1: return timers;
+		case 2: return fullRedraws;
+		case 3: return partialRedraws;
+		case 4: return reloads;
+		case 5: return draws;
+		case 6: return drawMs;
+		case 7: return heapBytesInUse;
+		case 8: return heapBytesPeak;
+		case 9: return persistBytesWritten;
+		case 10: return messageBytesIn;
+		case 11: return messageBytesOut;
+	}
+	return 0;
+}
+
+bool Diagnostics::write(DictionaryIterator* iter) const {
+	for (int i = 0; i < COUNTERS; ++i) {
+		if (dict_write_uint32(iter, FIRST_KEY + i, getValue(i)) != DICT_OK)
+			return false;
+	}
+	return true;
+}
+
+uint32_t getMessageSize(DictionaryIterator* iter) {
+	DictionaryIterator tuples = *iter;
+	uint32_t size = 1;
+	for (Tuple* tuple = dict_read_first(&tuples); tuple; tuple = dict_read_next(&tuples))
+		size += TUPLE_HEADER_SIZE + tuple->length;
+	return size;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "pebble.hpp"
+
+// What the app costs since launch, for the diagnostics window and the phone. The heap and flash
+// figures are the counters of pebble.cpp; the rest is counted where it happens in tracker.cpp.
+struct Diagnostics {
+	uint32_t ticks;
+	uint32_t timers;
+	uint32_t fullRedraws;
+	uint32_t partialRedraws;
+	uint32_t reloads;
+	uint32_t messageBytesIn;
+	uint32_t messageBytesOut;
+	uint32_t draws;
+	uint32_t drawMs;
+
+	// Counter i goes to the phone under FIRST_KEY + i as a uint32.
+	static char const* getName(int);
+	uint32_t getValue(int) const;
+	bool write(DictionaryIterator*) const;
+
+	static const int COUNTERS = 12;
+	static const uint32_t FIRST_KEY = 8000;
+};
+
+extern Diagnostics diagnostics;
+
+// Size of a message on the wire: a count byte, then each tuple with its header.
+uint32_t getMessageSize(DictionaryIterator*);
+
+// Milliseconds on a clock that wraps, good for differences.
+inline uint32_t getClockMs() {
+	time_t seconds;
+	uint16_t ms;
+	time_ms(&seconds, &ms);
+	return (uint32_t)seconds * 1000 + ms;
+}
@@ -0,0 +1,204 @@
+#include "history.hpp"
+#include "containers.hpp"
+
+static int writeVarint(uint8_t* s, uint32_t value) {
+	int length = 0;
+	for (; value >= 0x80; value >>= 7)
+		s[length++] = value | 0x80;
+	s[length++] = value;
+	return length;
+}
+
+static bool readVarint(uint8_t const* s, int size, int& offset, uint32_t& value) {
+	value = 0;
+	for (int shift = 0; offset < size && shift < 32; shift += 7) {
+		uint8_t byte = s[offset++];
+		value |= (uint32_t)(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+			return true;
+	}
+	return false;
+}
+
+// Signed values are zigzag encoded so that small negative deltas stay one byte.
+static uint32_t zigzag(int value) {
+	return (uint32_t)value << 1 ^ (uint32_t)(value >> 31);
+}
+
+static int unzigzag(uint32_t value) {
+	return (int)(value >> 1) ^ -(int)(value & 1);
+}
+
+static int readHeader(uint8_t const* s, uint16_t& sequence) {
+	sequence = s[0] | s[1] << 8;
+	return s[2] | s[3] << 8 | s[4] << 16 | s[5] << 24;
+}
+
+static bool decode(uint8_t const* s, int size, int& offset, int& time, HistoryEvent& event) {
+	uint32_t delta, head, value = 0;
+	if (!readVarint(s, size, offset, delta) || !readVarint(s, size, offset, head))
+		return false;
+	event.type = (HistoryEventType)(head & 3);
+	event.node = (int)(head >> 2) - 1;
+	if ((event.type == HISTORY_EDIT || event.type == HISTORY_RESET) && !readVarint(s, size, offset, value))
+		return false;
+	time += unzigzag(delta);
+	event.time = time;
+	event.value = event.type == HISTORY_EDIT ? unzigzag(value) : value;
+	return true;
+}
+
+History::History(uint32_t firstKey) : firstKey(firstKey) {
+}
+
+// Page s lives in key s % PAGES. Each starts with its sequence number and the time its first
+// delta counts from, so a page decodes on its own once older ones are overwritten.
+void History::record(HistoryEventType type, int node, int value) {
+	if (!loaded)
+		load();
+	int now = time(0L);
+	uint8_t buffer[MAX_RECORD_SIZE];
+	int length = writeVarint(buffer, zigzag(pageSize > 0 || pageCount > 0 ? now - lastTime : 0));
+	length += writeVarint(buffer + length, (uint32_t)(node + 1) << 2 | type);
+	if (type == HISTORY_EDIT)
+		length += writeVarint(buffer + length, zigzag(value));
+	else if (type == HISTORY_RESET)
+		length += writeVarint(buffer + length, value);
+
+	if (pageCount == 0) {
+		lastTime = now;
+		startPage();
+	}
+	else if (pageSize + length > PAGE_SIZE) {
+		startPage();
+	}
+	memcpy(page + pageSize, buffer, length);
+	pageSize += length;
+	lastTime = now;
+	dirty = true;
+}
+
+bool History::flush() {
+	bool written = true;
+	if (sealedSize > 0) {
+		written = writePage(sequence - 1, sealed, sealedSize);
+		sealedSize = 0;
+	}
+	if (dirty) {
+		written = writePage(sequence, page, pageSize) && written;
+		dirty = false;
+	}
+	return written;
+}
+
+void History::clear() {
+	for (int i = 0; i < PAGES; ++i)
+		persist_delete(firstKey + i);
+	loaded = true;
+	pageSize = sealedSize = pageCount = 0;
+	dirty = false;
+}
+
+// Finds the newest page and replays its deltas to know the time the next record counts from.
+void History::load() {
+	loaded = true;
+	pageCount = 0;
+	for (int i = 0; i < PAGES; ++i) {
+		uint8_t header[PAGE_HEADER_SIZE];
+		uint16_t s;
+		if (persist_read_data(firstKey + i, header, sizeof(header)) != PAGE_HEADER_SIZE)
+			continue;
+		readHeader(header, s);
+		if (pageCount == 0 || (int16_t)(s - sequence) > 0)
+			sequence = s;
+		++pageCount;
+	}
+	if (pageCount == 0)
+		return;
+	pageSize = readPage(sequence, page);
+	if (pageSize == 0) {
+		clear();
+		return;
+	}
+	uint16_t s;
+	lastTime = readHeader(page, s);
+	HistoryEvent event;
+	for (int offset = PAGE_HEADER_SIZE; offset < pageSize && decode(page, pageSize, offset, lastTime, event);)
+		;
+}
+
+// A full page waits in RAM for the next flush; only a second one filling up before that forces a write.
+void History::startPage() {
+	if (pageSize > 0) {
+		if (sealedSize > 0)
+			writePage(sequence - 1, sealed, sealedSize);
+		memcpy(sealed, page, pageSize);
+		sealedSize = pageSize;
+		++sequence;
+	}
+	pageCount = min(pageCount + 1, PAGES);
+	page[0] = sequence & 0xFF;
+	page[1] = sequence >> 8;
+	for (int i = 0; i < 4; ++i)
+		page[2 + i] = (uint32_t)lastTime >> 8 * i;
+	pageSize = PAGE_HEADER_SIZE;
+}
+
+int History::readPage(uint16_t s, uint8_t* out) {
+	if (!loaded)
+		load();
+	if (s == sequence && pageSize > 0) {
+		memcpy(out, page, pageSize);
+		return pageSize;
+	}
+	if (s == (uint16_t)(sequence - 1) && sealedSize > 0) {
+		memcpy(out, sealed, sealedSize);
+		return sealedSize;
+	}
+	int size = persist_read_data(firstKey + s % PAGES, out, PAGE_SIZE);
+	uint16_t stored;
+	if (size < PAGE_HEADER_SIZE)
+		return 0;
+	readHeader(out, stored);
+	return stored == s ? size : 0;
+}
+
+bool History::writePage(uint16_t s, uint8_t const* data, int size) {
+	if (persistWrite(firstKey + s % PAGES, data, size) < 0) {
+		app_log(APP_LOG_LEVEL_WARNING, __FILE__, __LINE__, "history page %d not saved", s);
+		return false;
+	}
+	return true;
+}
+
+int History::getPageCount() {
+	if (!loaded)
+		load();
+	return pageCount;
+}
+
+uint16_t History::getNewestSequence() {
+	if (!loaded)
+		load();
+	return sequence;
+}
+
+HistoryReader::HistoryReader(History& history) : history(history) {
+	pagesLeft = history.getPageCount();
+	nextPage = history.getNewestSequence() - pagesLeft + 1;
+}
+
+bool HistoryReader::next(HistoryEvent& event) {
+	while (offset >= pageSize || !decode(page, pageSize, offset, time, event)) {
+		if (pagesLeft == 0)
+			return false;
+		--pagesLeft;
+		pageSize = history.readPage(nextPage++, page);
+		if (pageSize > 0) {
+			uint16_t s;
+			time = readHeader(page, s);
+			offset = History::PAGE_HEADER_SIZE;
+		}
+	}
+	return true;
+}
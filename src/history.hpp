@@ -0,0 +1,77 @@
+#pragma once
+
+#include "pebble.hpp"
+
+enum HistoryEventType { HISTORY_START, HISTORY_STOP, HISTORY_EDIT, HISTORY_RESET };
+
+// A start names the node that accrues from then on and a stop ends accrual. An edit names the
+// node, or NULL_V for the accumulated total, and the seconds it moved by. A reset is 1 when the
+// accumulated total was cleared too.
+struct HistoryEvent {
+	int time;
+	HistoryEventType type;
+	int node;
+	int value;
+};
+
+// Append-only event log over a ring of persist pages, the oldest page being overwritten first.
+// Records are varints: the seconds since the previous record, the type and node, and the value
+// of edits and resets, so most take two or three bytes. Records collect in RAM until flush().
+class History {
+public:
+	History(uint32_t);
+
+	void record(HistoryEventType, int, int);
+	bool flush();
+	void clear();
+
+	bool hasPending() const {
+		return dirty || sealedSize > 0;
+	}
+
+	// For copying the log page by page: pages run from getNewestSequence() - getPageCount() + 1
+	// to the newest, and readPage() returns 0 for one that was overwritten meanwhile.
+	int getPageCount();
+	uint16_t getNewestSequence();
+	int readPage(uint16_t, uint8_t*);
+
+	static const int PAGES = 8;
+	static const int PAGE_SIZE = 128;
+	static const int PAGE_HEADER_SIZE = 6;
+
+private:
+	void load();
+	void startPage();
+	bool writePage(uint16_t, uint8_t const*, int);
+
+	static const int MAX_RECORD_SIZE = 15;
+
+	uint32_t firstKey;
+	bool loaded = false;
+	uint8_t page[PAGE_SIZE];
+	int pageSize = 0;
+	bool dirty = false;
+	uint8_t sealed[PAGE_SIZE];
+	int sealedSize = 0;
+	uint16_t sequence = 0;
+	int pageCount = 0;
+	int lastTime = 0;
+};
+
+// Walks the log from the oldest record, reading one page at a time and including records that
+// are not flushed yet.
+class HistoryReader {
+public:
+	HistoryReader(History&);
+
+	bool next(HistoryEvent&);
+
+private:
+	History& history;
+	uint16_t nextPage;
+	int pagesLeft;
+	uint8_t page[History::PAGE_SIZE];
+	int pageSize = 0;
+	int offset = 0;
+	int time = 0;
+};
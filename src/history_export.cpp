@@ -0,0 +1,56 @@
+#include "history_export.hpp"
+
+// The pages to send are fixed when the export starts; pages added later go with the next one.
+HistoryExport::HistoryExport(History& history, TrackingList const& list, int outboxSize) : history(history), list(list), chunkSize(min(outboxSize - MESSAGE_OVERHEAD, MAX_CHUNK_SIZE)) {
+	pagesLeft = writtenPagesLeft = history.getPageCount();
+	nextPage = writtenNextPage = history.getNewestSequence() - pagesLeft + 1;
+}
+
+bool HistoryExport::write(DictionaryIterator* iter) {
+	int size = 0;
+	writtenNextPage = nextPage;
+	writtenPagesLeft = pagesLeft;
+	if (chunk == 0) {
+		for(int i = 0; i < list.getNodeCapacity(); ++i) {
+			char const* name = list.getNodeName(i);
+			int length = strlen(name);
+			if (size + length + 2 > chunkSize)
+				break;
+			if (i > 0)
+				buffer[size++] = '\n';
+			memcpy(buffer + size, name, length);
+			size += length;
+		}
+		buffer[size] = '\0';
+		if (dict_write_cstring(iter, NAMES_KEY, (char const*)buffer) != DICT_OK)
+			return false;
+	}
+	else {
+		for(; writtenPagesLeft > 0; --writtenPagesLeft, ++writtenNextPage) {
+			if (size + 1 + History::PAGE_SIZE > chunkSize)
+				break;
+			int length = history.readPage(writtenNextPage, buffer + size + 1);
+			if (length > 0) {
+				buffer[size] = length;
+				size += 1 + length;
+			}
+		}
+		// An outbox too small for a single page would never finish.
+		if (writtenPagesLeft == pagesLeft)
+			return false;
+		if (dict_write_data(iter, DATA_KEY, buffer, size) != DICT_OK)
+			return false;
+	}
+	if (dict_write_int32(iter, CHUNK_KEY, chunk) != DICT_OK)
+		return false;
+	if (writtenPagesLeft == 0 && dict_write_int32(iter, END_KEY, chunk + 1) != DICT_OK)
+		return false;
+	return true;
+}
+
+void HistoryExport::acknowledge() {
+	done = writtenPagesLeft == 0;
+	nextPage = writtenNextPage;
+	pagesLeft = writtenPagesLeft;
+	++chunk;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "tracker_data.hpp"
+
+// Streams the history log to the phone. The first chunk carries the node names, joined by
+// newlines in node order, and every later one as many whole log pages as fit, each prefixed by
+// its length. Chunks are numbered; one that is not acknowledged is written again unchanged, so
+// the phone drops repeats by number and an export resumes where the link broke. Chunks are sized
+// by the outbox AppMessage actually opened, which older firmware keeps smaller than asked for.
+class HistoryExport {
+public:
+	HistoryExport(History&, TrackingList const&, int outboxSize);
+
+	bool write(DictionaryIterator*);
+	void acknowledge();
+
+	bool isDone() const {
+		return done;
+	}
+	int getChunk() const {
+		return chunk;
+	}
+
+	static const uint32_t CHUNK_KEY = 6000;
+	static const uint32_t NAMES_KEY = 6001;
+	static const uint32_t DATA_KEY = 6002;
+	static const uint32_t END_KEY = 6003;
+	static const int OUTBOX_SIZE = 1024;
+	// Dictionary header and the chunk, end and data tuple headers.
+	static const int MESSAGE_OVERHEAD = 32;
+	static const int MAX_CHUNK_SIZE = OUTBOX_SIZE - MESSAGE_OVERHEAD;
+
+private:
+	History& history;
+	TrackingList const& list;
+	int chunkSize;
+	int chunk = 0;
+	uint16_t nextPage;
+	int pagesLeft;
+	uint16_t writtenNextPage;
+	int writtenPagesLeft;
+	bool done = false;
+	uint8_t buffer[MAX_CHUNK_SIZE];
+};
@@ -0,0 +1,153 @@
+#include "journal.hpp"
+
+Journal::Journal(uint32_t firstKey) : firstKey(firstKey) {
+}
+
+// Restores the newest checkpoint and replays the pages of its generation in order, stopping at
+// the first page that is missing, stale or malformed.
+int Journal::load(void* s, int length) {
+	imageSize = pageSize = pageIndex = 0;
+	int newest = -1;
+	for (int i = 0; i < CHECKPOINT_SLOTS; ++i) {
+		uint8_t header[GENERATION_SIZE];
+		if (persist_get_size(firstKey + i) <= GENERATION_SIZE)
+			continue;
+		persist_read_data(firstKey + i, header, sizeof(header));
+		uint16_t g = header[0] | header[1] << 8;
+		if (newest == -1 || (int16_t)(g - generation) > 0) {
+			newest = i;
+			generation = g;
+		}
+	}
+	if (newest == -1)
+		return 0;
+	checkpointSlot = newest;
+	imageSize = persist_read_data(firstKey + newest, image, sizeof(image)) - GENERATION_SIZE;
+
+	uint8_t buffer[PAGE_SIZE];
+	for (int i = 0; i < PAGES; ++i) {
+		int size = persist_read_data(firstKey + CHECKPOINT_SLOTS + i, buffer, sizeof(buffer));
+		if (size < PAGE_HEADER_SIZE || memcmp(buffer, image, GENERATION_SIZE) != 0 || buffer[GENERATION_SIZE] != i ||
+				!apply(buffer + PAGE_HEADER_SIZE, size - PAGE_HEADER_SIZE))
+			break;
+		memcpy(page, buffer, size);
+		pageSize = size;
+		pageIndex = i;
+	}
+
+	if (imageSize > length)
+		return 0;
+	memcpy(s, image + GENERATION_SIZE, imageSize);
+	return imageSize;
+}
+
+bool Journal::append(void const* s, int size) {
+	if (size > MAX_IMAGE_SIZE)
+		return false;
+	if (imageSize == 0)
+		return checkpoint(s, size);
+
+	uint8_t records[PAGE_SIZE - PAGE_HEADER_SIZE];
+	int length = diff((uint8_t const*)s, size, records, sizeof(records));
+	if (length == 0)
+		return true;
+	if (length < 0 || (pageSize + length > PAGE_SIZE && pageIndex + 1 == PAGES))
+		return checkpoint(s, size);
+
+	int index = pageIndex;
+	int start = pageSize;
+	if (start == 0 || start + length > PAGE_SIZE) {
+		if (start > 0)
+			++index;
+		memcpy(page, image, GENERATION_SIZE);
+		page[GENERATION_SIZE] = index;
+		start = PAGE_HEADER_SIZE;
+	}
+	memcpy(page + start, records, length);
+	if (persistWrite(firstKey + CHECKPOINT_SLOTS + index, page, start + length) < 0) {
+		if (pageSize > 0)
+			persist_read_data(firstKey + CHECKPOINT_SLOTS + pageIndex, page, sizeof(page));
+		return false;
+	}
+	pageIndex = index;
+	pageSize = start + length;
+	memcpy(image + GENERATION_SIZE, s, size);
+	imageSize = size;
+	return true;
+}
+
+bool Journal::checkpoint(void const* s, int size) {
+	if (size > MAX_IMAGE_SIZE)
+		return false;
+	uint16_t next = generation + 1;
+	int slot = (checkpointSlot + 1) % CHECKPOINT_SLOTS;
+	image[0] = next & 0xFF;
+	image[1] = next >> 8;
+	memcpy(image + GENERATION_SIZE, s, size);
+	if (persistWrite(firstKey + slot, image, GENERATION_SIZE + size) < 0) {
+		imageSize = 0;
+		return false;
+	}
+	generation = next;
+	checkpointSlot = slot;
+	imageSize = size;
+	pageIndex = pageSize = 0;
+	return true;
+}
+
+void Journal::clear() {
+	for (int i = 0; i < CHECKPOINT_SLOTS + PAGES; ++i)
+		persist_delete(firstKey + i);
+	imageSize = pageSize = pageIndex = 0;
+}
+
+// Records are an offset and a length followed by the new bytes, or SIZE_RECORD and the new image
+// size. Differing runs separated by less than a record header are merged into one record.
+int Journal::diff(uint8_t const* s, int size, uint8_t* out, int capacity) const {
+	uint8_t const* old = image + GENERATION_SIZE;
+	int length = 0;
+	if (size != imageSize) {
+		out[length++] = SIZE_RECORD;
+		out[length++] = size;
+	}
+	for (int i = 0; i < size;) {
+		if (i < imageSize && s[i] == old[i]) {
+			++i;
+			continue;
+		}
+		int end = i + 1;
+		for (int j = end; j < size && j - end < RECORD_HEADER_SIZE; ++j) {
+			if (j >= imageSize || s[j] != old[j])
+				end = j + 1;
+		}
+		if (length + RECORD_HEADER_SIZE + end - i > capacity)
+			return -1;
+		out[length++] = i;
+		out[length++] = end - i;
+		memcpy(out + length, s + i, end - i);
+		length += end - i;
+		i = end;
+	}
+	return length;
+}
+
+bool Journal::apply(uint8_t const* records, int length) {
+	for (int i = 0; i < length;) {
+		if (i + RECORD_HEADER_SIZE > length)
+			return false;
+		int offset = records[i];
+		int count = records[i + 1];
+		i += RECORD_HEADER_SIZE;
+		if (offset == SIZE_RECORD) {
+			if (count > MAX_IMAGE_SIZE)
+				return false;
+			imageSize = count;
+			continue;
+		}
+		if (offset + count > imageSize || i + count > length)
+			return false;
+		memcpy(image + GENERATION_SIZE + offset, records + i, count);
+		i += count;
+	}
+	return true;
+}
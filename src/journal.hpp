@@ -0,0 +1,46 @@
+#pragma once
+
+#include "pebble.hpp"
+
+// Crash-safe store for the serialized state. A checkpoint alternates between two keys and every
+// later save appends the changed byte ranges to a journal page; the pages rotate over a few keys
+// and a full journal is folded into the next checkpoint. Each save is a single persist write.
+class Journal {
+public:
+	Journal(uint32_t);
+
+	int load(void*, int);
+	bool append(void const*, int);
+	bool checkpoint(void const*, int);
+	void clear();
+
+	int getGeneration() const {
+		return generation;
+	}
+	int getPageCount() const {
+		return pageSize > 0 ? pageIndex + 1 : 0;
+	}
+
+	static const int CHECKPOINT_SLOTS = 2;
+	static const int PAGES = 4;
+	static const int PAGE_SIZE = 64;
+	static const int MAX_IMAGE_SIZE = PERSIST_DATA_MAX_LENGTH - 2;
+
+private:
+	int diff(uint8_t const*, int, uint8_t*, int) const;
+	bool apply(uint8_t const*, int);
+
+	static const int GENERATION_SIZE = 2;
+	static const int PAGE_HEADER_SIZE = GENERATION_SIZE + 1;
+	static const int RECORD_HEADER_SIZE = 2;
+	static const uint8_t SIZE_RECORD = 0xFF;
+
+	uint32_t firstKey;
+	uint8_t image[GENERATION_SIZE + MAX_IMAGE_SIZE];
+	int imageSize = 0;
+	uint8_t page[PAGE_SIZE];
+	int pageSize = 0;
+	int pageIndex = 0;
+	uint16_t generation = 0;
+	int checkpointSlot = 0;
+};
@@ -1,7 +1,23 @@
 var DEFAULT_TOTAL_HOURS = 8;
 var DEFAULT_ACC_TOTAL_HOURS = 40;
-var SEND_ELEMENTS_KEYMAP = 10;
-var SEND_HOURS_KEYMAP = 1000;
+var CONFIG_VERSION = 2;
+var CONFIG_SIZE_KEY = 7000;
+var CONFIG_OFFSET_KEY = 7001;
+var CONFIG_DATA_KEY = 7002;
+var CONFIG_CHUNK_SIZE = 64;
+var CONFIG_RETRIES = 3;
+// The watch drops a config over ConfigReceiver::MAX_SIZE bytes, and one of more than
+// TrackingList::MAX_NODES slots and pairs, as its state would not fit one journal image.
+var CONFIG_MAX_SIZE = 256;
+var CONFIG_MAX_NODES = 47;
+var EXPORT_CHUNK_KEY = 6000;
+var EXPORT_NAMES_KEY = 6001;
+var EXPORT_DATA_KEY = 6002;
+var EXPORT_END_KEY = 6003;
+var HISTORY_EVENTS = ["start", "stop", "edit", "reset"];
+var DIAGNOSTICS_KEY = 8000;
+var DIAGNOSTICS_NAMES = ["ticks", "timers", "full redraws", "partial redraws", "reloads", "draws", "draw ms",
+	"heap", "heap peak", "flash bytes", "bytes in", "bytes out"];
 
 function defaultTree() {
 	return [
@@ -34,34 +50,180 @@ function defaultTree() {
 	];
 }
 
-function encodeTree(treeNodes, encTree, counter) {
-	for(var i = 0; i < treeNodes.length; i++) {
-		var node = treeNodes[i];
-		var childs = node.children;
-		if (childs) {
-			counter.pairs_index++;
-			var j = 2 * counter.pairs_index - 1;
-			encTree[j] = childs[0].text.value + childs[1].text.value;
-			encTree[j + 1] = node.text.value;
-			encodeTree(childs, encTree, counter);
-		}
-		else {
-			counter.elements_index++;
-			var k = 2 * counter.elements_index - 1;
-			encTree[SEND_ELEMENTS_KEYMAP * k] = node.text.value;
-			encTree[SEND_ELEMENTS_KEYMAP * (k + 1)] = node.text.priority;
+function countLeaves(treeNodes) {
+	var count = 0;
+	for (var i = 0; i < treeNodes.length; i++)
+		count += treeNodes[i].children ? countLeaves(treeNodes[i].children) : 1;
+	return count;
+}
+
+function pushName(bytes, name) {
+	var utf8 = unescape(encodeURIComponent(name));
+	for (var i = 0; i < utf8.length; i++)
+		bytes.push(utf8.charCodeAt(i));
+	bytes.push(0);
+}
+
+// Goals and budgets are minutes of a node, 1 to 65535; the pattern is the watch's vibe for it.
+var GOAL_PATTERN = 1;
+var BUDGET_PATTERN = 2;
+var MAX_GOALS = 16;
+
+function pushGoal(config, slot, minutes, pattern) {
+	minutes = parseInt(minutes, 10);
+	if (!(minutes > 0) || config.goals.length >= MAX_GOALS * 4)
+		return;
+	minutes = Math.min(minutes, 0xFFFF);
+	config.goals.push(slot, pattern, minutes & 0xFF, minutes >> 8 & 0xFF);
+}
+
+// Leaves take the node slots in tree order and every pair the next slot after its two elements,
+// so a pair only refers to slots before its own. Returns the slot of the node.
+function encodeNode(node, config) {
+	var childs = node.children;
+	var slot;
+	if (!childs) {
+		config.leaves.push(node.text.priority & 0xFF);
+		pushName(config.leaves, node.text.value);
+		slot = config.leafCount++;
+	}
+	else {
+		var element1 = encodeNode(childs[0], config);
+		var element2 = encodeNode(childs[1], config);
+		config.pairs.push(element1, element2);
+		pushName(config.pairs, node.text.value);
+		slot = config.leafTotal + config.pairCount++;
+	}
+	pushGoal(config, slot, node.text.goal, GOAL_PATTERN);
+	pushGoal(config, slot, node.text.budget, BUDGET_PATTERN);
+	return slot;
+}
+
+// The same blob the watch keeps in its config key: version, leaf count, pair count, total hours,
+// total accumulated hours (2 bytes, little endian), the leaves and pairs, the goal count and the
+// slot, pattern and minutes (2 bytes, little endian) of every goal, and a Fletcher-16 checksum.
+function encodeConfig(tree, total, accTotal) {
+	var config = { leaves: [], pairs: [], goals: [], leafCount: 0, pairCount: 0, leafTotal: countLeaves(tree) };
+	for (var i = 0; i < tree.length; i++)
+		encodeNode(tree[i], config);
+	var bytes = [CONFIG_VERSION, config.leafCount, config.pairCount, total & 0xFF, accTotal & 0xFF, accTotal >> 8 & 0xFF];
+	bytes = bytes.concat(config.leaves, config.pairs, [config.goals.length / 4], config.goals);
+	var sum1 = 0, sum2 = 0;
+	for (var j = 0; j < bytes.length; j++) {
+		sum1 = (sum1 + bytes[j]) % 255;
+		sum2 = (sum2 + sum1) % 255;
+	}
+	bytes.push(sum1, sum2);
+	return bytes;
+}
+
+// Chunks go out one at a time, each after the previous one is acked, and a nacked one is sent
+// again; they are small enough for the smallest inbox.
+function sendConfig(bytes, offset, retries) {
+	var message = {};
+	message[CONFIG_SIZE_KEY] = bytes.length;
+	message[CONFIG_OFFSET_KEY] = offset;
+	message[CONFIG_DATA_KEY] = bytes.slice(offset, offset + CONFIG_CHUNK_SIZE);
+	Pebble.sendAppMessage(message, function() {
+		if (offset + CONFIG_CHUNK_SIZE < bytes.length)
+			sendConfig(bytes, offset + CONFIG_CHUNK_SIZE, 0);
+		else
+			console.log("tree sent to Pebble successfully");
+	}, function(e) {
+		if (retries < CONFIG_RETRIES)
+			sendConfig(bytes, offset, retries + 1);
+		else
+			console.log("tree not sent to Pebble: " + JSON.stringify(e));
+	});
+}
+
+// The watch resends a chunk it got no ack for, so chunks are kept by number and a repeat replaces
+// the earlier copy.
+var exportChunks = {};
+
+function readVarint(bytes, pos) {
+	var value = 0;
+	for (var shift = 0; pos.offset < bytes.length; shift += 7) {
+		var b = bytes[pos.offset++];
+		value += (b & 0x7F) * Math.pow(2, shift);
+		if (!(b & 0x80))
+			return value;
+	}
+	return null;
+}
+
+function unzigzag(value) {
+	return value % 2 ? -(value + 1) / 2 : value / 2;
+}
+
+function decodePage(page, names, lines) {
+	var time = page[2] | page[3] << 8 | page[4] << 16 | page[5] << 24;
+	var pos = { offset: 6 };
+	while (pos.offset < page.length) {
+		var delta = readVarint(page, pos);
+		var head = readVarint(page, pos);
+		if (delta === null || head === null)
+			return;
+		var type = head & 3;
+		var node = (head >> 2) - 1;
+		var value = "";
+		if (type === 2 || type === 3) {
+			value = readVarint(page, pos);
+			if (value === null)
+				return;
+			if (type === 2)
+				value = unzigzag(value);
 		}
+		time += unzigzag(delta);
+		lines.push([new Date(time * 1000).toISOString(), HISTORY_EVENTS[type], node < 0 ? "" : names[node], value].join(","));
 	}
 }
 
-function appMessageAck() {
-	console.log("tree sent to Pebble successfully");
+function decodeExport(chunkCount) {
+	var names = exportChunks[0][EXPORT_NAMES_KEY].split("\n");
+	var lines = ["time,event,node,value"];
+	for (var i = 1; i < chunkCount; i++) {
+		var data = exportChunks[i][EXPORT_DATA_KEY];
+		for (var offset = 0; offset < data.length; offset += 1 + data[offset])
+			decodePage(data.slice(offset + 1, offset + 1 + data[offset]), names, lines);
+	}
+	return lines.join("\n");
 }
 
-function appMessageNack(e) {
-	console.log("tree not sent to Pebble: " + JSON.stringify(e));
+function saveDiagnostics(payload) {
+	var counters = {};
+	for (var i = 0; i < DIAGNOSTICS_NAMES.length; i++)
+		counters[DIAGNOSTICS_NAMES[i]] = payload[DIAGNOSTICS_KEY + i];
+	localStorage.setItem('diagnostics', JSON.stringify(counters));
+	console.log("diagnostics = " + JSON.stringify(counters));
 }
 
+Pebble.addEventListener("appmessage", function(e) {
+	if (e.payload[DIAGNOSTICS_KEY] !== undefined) {
+		saveDiagnostics(e.payload);
+		return;
+	}
+	var chunk = e.payload[EXPORT_CHUNK_KEY];
+	if (chunk === undefined)
+		return;
+	if (chunk === 0)
+		exportChunks = {};
+	exportChunks[chunk] = e.payload;
+	var end = e.payload[EXPORT_END_KEY];
+	if (end === undefined)
+		return;
+	for (var i = 0; i < end; i++) {
+		if (!exportChunks[i]) {
+			console.log("history export is missing chunk " + i);
+			return;
+		}
+	}
+	var csv = decodeExport(end);
+	localStorage.setItem('history', csv);
+	console.log("history = " + csv);
+	exportChunks = {};
+});
+
 Pebble.addEventListener("showConfiguration", function() {
 	var tree = JSON.parse(localStorage.getItem('tree'));
 	var total = localStorage.getItem('total');
@@ -86,16 +248,17 @@ Pebble.addEventListener("webviewclosed", function(e) {
 		localStorage.setItem('total', data[1]);
 		localStorage.setItem('acctotal', data[2]);
 
-		var encTree = {};
-		var counter = {};
-		counter.pairs_index = 0;
-		counter.elements_index = 0;
-		encodeTree(data[0], encTree, counter);
-		encTree[SEND_HOURS_KEYMAP * 1] = parseInt(data[1]);
-		encTree[SEND_HOURS_KEYMAP * 2] = parseInt(data[2]);
-		console.log("encoded data = " + JSON.stringify(encTree));
-
-		Pebble.sendAppMessage(encTree, appMessageAck, appMessageNack);
+		var config = encodeConfig(data[0], parseInt(data[1]), parseInt(data[2]));
+		console.log("encoded config = " + JSON.stringify(config));
+		// The tree is kept, so the config page opens on it again to be trimmed.
+		if (config.length > CONFIG_MAX_SIZE || config[1] + config[2] > CONFIG_MAX_NODES) {
+			console.log("tree not sent to Pebble: " + config.length + " bytes, " + (config[1] + config[2]) + " slots");
+			Pebble.showSimpleNotificationOnPebble("Tracker", "The tree is too big for the watch. " +
+				"Remove slots or goals and save it again.");
+		}
+		else {
+			sendConfig(config, 0, 0);
+		}
 	}
 	else {
 		console.log("got no changes");
@@ -1,33 +1,219 @@
 #include "pebble.hpp"
 
+uint32_t allocationCount;
+uint32_t allocatedBytes;
+uint32_t heapBytesInUse;
+uint32_t heapBytesPeak;
+uint32_t persistBytesWritten;
+
+#ifdef TRACKER_PROFILE_ALLOCATIONS
+// Live blocks are linked through their headers, so leaks are found by walking the list, and each
+// names the call site it came from. A pointer is only freed once it is found on that list, so a
+// bad free never reads memory malloc owns. Freed blocks wait in a quarantine before going back to
+// malloc, which keeps their addresses from being handed out again while a double free of them is
+// still likely, and tells double frees from frees of pointers never allocated.
+struct BlockHeader {
+	BlockHeader* previous;
+	BlockHeader* next;
+	uint32_t size;
+	uint16_t site;
+	uint16_t generation;
+};
+
+struct AllocationSite {
+	uintptr_t address;
+	uint32_t calls;
+	uint32_t bytes;
+	uint32_t liveBlocks;
+	uint32_t liveBytes;
+	uint32_t peakBytes;
+};
+
+static const size_t BLOCK_HEADER_SIZE = (sizeof(BlockHeader) + alignof(max_align_t) - 1) / alignof(max_align_t) * alignof(max_align_t);
+static const int QUARANTINE_SIZE = 16;
+// The last site collects the calls from every site that did not get one of its own.
+static const int MAX_SITES = 64;
+
+static AllocationSite sites[MAX_SITES];
+static int siteCount;
+static BlockHeader* liveBlocks;
+static uint16_t generation;
+static uint32_t doubleFrees;
+static uint32_t foreignFrees;
+static BlockHeader* quarantine[QUARANTINE_SIZE];
+static int quarantineNext;
+
+static int findSite(uintptr_t address) {
+	for (int i = 0; i < siteCount; ++i) {
+		if (sites[i].address == address)
+			return i;
+	}
+	if (siteCount == MAX_SITES - 1)
+		return MAX_SITES - 1;
+	sites[siteCount].address = address;
+	return siteCount++;
+}
+
+static void* allocate(size_t size, void* caller) {
+	BlockHeader* block = (BlockHeader*)malloc(BLOCK_HEADER_SIZE + size);
+	if (!block)
+		return NULL;
+	++allocationCount;
+	allocatedBytes += size;
+	heapBytesInUse += size;
+	if (heapBytesInUse > heapBytesPeak)
+		heapBytesPeak = heapBytesInUse;
+
+	AllocationSite& site = sites[block->site = findSite((uintptr_t)caller)];
+	++site.calls;
+	site.bytes += size;
+	++site.liveBlocks;
+	site.liveBytes += size;
+	if (site.liveBytes > site.peakBytes)
+		site.peakBytes = site.liveBytes;
+
+	block->size = size;
+	block->generation = generation;
+	block->previous = NULL;
+	block->next = liveBlocks;
+	if (liveBlocks)
+		liveBlocks->previous = block;
+	liveBlocks = block;
+	return (uint8_t*)block + BLOCK_HEADER_SIZE;
+}
+
+static bool isQuarantined(void* ptr) {
+	for (int i = 0; i < QUARANTINE_SIZE; ++i) {
+		if (quarantine[i] && (uint8_t*)quarantine[i] + BLOCK_HEADER_SIZE == ptr)
+			return true;
+	}
+	return false;
+}
+
+static BlockHeader* findLiveBlock(void* ptr) {
+	for (BlockHeader* block = liveBlocks; block; block = block->next) {
+		if ((uint8_t*)block + BLOCK_HEADER_SIZE == ptr)
+			return block;
+	}
+	return NULL;
+}
+
+static void release(void* ptr) {
+	if (!ptr)
+		return;
+	BlockHeader* block = findLiveBlock(ptr);
+	if (!block) {
+		bool freed = isQuarantined(ptr);
+		++(freed ? doubleFrees : foreignFrees);
+		app_log(APP_LOG_LEVEL_ERROR, __FILE__, __LINE__, freed ? "double free of %p" : "free of unknown %p", ptr);
+		return;
+	}
+	heapBytesInUse -= block->size;
+	AllocationSite& site = sites[block->site];
+	--site.liveBlocks;
+	site.liveBytes -= block->size;
+
+	if (block->previous)
+		block->previous->next = block->next;
+	else
+		liveBlocks = block->next;
+	if (block->next)
+		block->next->previous = block->previous;
+	free(quarantine[quarantineNext]);
+	quarantine[quarantineNext] = block;
+	quarantineNext = (quarantineNext + 1) % QUARANTINE_SIZE;
+}
+
+void markAllocations() {
+	++generation;
+}
+
+// Sites are printed as offsets from this function; adding its address from the symbol table of
+// the binary gives an address for addr2line.
+int reportAllocations() {
+	uint16_t leakedBlocks[MAX_SITES] = {};
+	uint32_t leakedBytes[MAX_SITES] = {};
+	int leaks = 0;
+	for (BlockHeader* block = liveBlocks; block; block = block->next) {
+		if (block->generation == generation) {
+			++leakedBlocks[block->site];
+			leakedBytes[block->site] += block->size;
+			++leaks;
+		}
+	}
+	app_log(APP_LOG_LEVEL_INFO, __FILE__, __LINE__, "%lu allocations of %lu bytes, %lu bytes live, peak %lu",
+		(unsigned long)allocationCount, (unsigned long)allocatedBytes, (unsigned long)heapBytesInUse, (unsigned long)heapBytesPeak);
+	for (int i = 0; i < MAX_SITES; ++i) {
+		AllocationSite const& site = sites[i];
+		if (site.calls == 0)
+			continue;
+		long offset = (long)(site.address - (uintptr_t)&reportAllocations);
+		app_log(APP_LOG_LEVEL_INFO, __FILE__, __LINE__, "site %c0x%lx: %lu calls of %lu bytes, %lu live of %lu bytes, peak %lu, %u since mark",
+			offset < 0 ? '-' : '+', (unsigned long)(offset < 0 ? -offset : offset),
+			(unsigned long)site.calls, (unsigned long)site.bytes, (unsigned long)site.liveBlocks,
+			(unsigned long)site.liveBytes, (unsigned long)site.peakBytes, leakedBlocks[i]);
+	}
+	app_log(APP_LOG_LEVEL_INFO, __FILE__, __LINE__, "%d blocks live since mark, %lu double frees, %lu frees of unknown blocks",
+		leaks, (unsigned long)doubleFrees, (unsigned long)foreignFrees);
+	return leaks + doubleFrees + foreignFrees;
+}
+
 void* operator new(size_t size) {
-	return malloc(size);
+	return allocate(size, __builtin_return_address(0));
 }
 
 void* operator new[](size_t size) {
-	return malloc(size);
+	return allocate(size, __builtin_return_address(0));
+}
+#else
+// Blocks go straight to malloc with nothing added, so counting costs the heap nothing; the bytes
+// in use come from sampleHeap() instead.
+static void* allocate(size_t size) {
+	void* block = malloc(size);
+	if (!block)
+		return NULL;
+	++allocationCount;
+	allocatedBytes += size;
+	return block;
 }
 
-void operator delete(void *ptr) {
+static void release(void* ptr) {
 	free(ptr);
 }
 
+void* operator new(size_t size) {
+	return allocate(size);
+}
+
+void* operator new[](size_t size) {
+	return allocate(size);
+}
+#endif
+
+void operator delete(void *ptr) {
+	release(ptr);
+}
+
 void operator delete[](void *ptr) {
-	free(ptr);
+	release(ptr);
 }
 
-namespace std {
-	void __throw_bad_alloc(void) {}
-	void __throw_bad_function_call(void) {}
-	void __throw_length_error(const char*) {} 
-	void __throw_out_of_range(const char*) {}
-	void __throw_runtime_error(const char*) {}
-	void __throw_logic_error(const char*) {}
+void sampleHeap() {
+#ifndef TRACKER_PROFILE_ALLOCATIONS
+	heapBytesInUse = heap_bytes_used();
+	if (heapBytesInUse > heapBytesPeak)
+		heapBytesPeak = heapBytesInUse;
+#endif
 }
 
-#define _FUNCTEXCEPT_H 1
-#include <bits/exception_defines.h>
+int persistWrite(uint32_t key, void const* data, size_t size) {
+	int written = persist_write_data(key, data, size);
+	if (written > 0)
+		persistBytesWritten += written;
+	return written;
+}
 
+#ifndef TRACKER_HOST
 extern "C" void _exit (int) {
   while(1) {};
 }
@@ -40,3 +226,4 @@ extern "C" void _kill(int pid) { while(1); }
 
 int __exidx_start = 0;
 int __exidx_end = 0;
+#endif
@@ -3,3 +3,25 @@ extern "C" {
 	#include <pebble.h>
 	int snprintf(char*, size_t, const char*, ...);
 }
+
+// Calls and bytes of operator new since start, for benchmarks and diagnostics.
+extern uint32_t allocationCount;
+extern uint32_t allocatedBytes;
+// Heap bytes in use and the most there were. The allocation profile counts them exactly in operator
+// new and delete; otherwise they are the SDK's figure as of the last sampleHeap().
+extern uint32_t heapBytesInUse;
+extern uint32_t heapBytesPeak;
+void sampleHeap();
+// Bytes written with persistWrite() since start.
+extern uint32_t persistBytesWritten;
+
+// persist_write_data() that counts the bytes it wrote.
+int persistWrite(uint32_t key, void const* data, size_t size);
+
+#ifdef TRACKER_PROFILE_ALLOCATIONS
+// Profile kept by operator new and delete per call site: calls, bytes, live and peak bytes, and
+// frees of blocks already freed or never allocated. Blocks allocated after the last mark and still
+// live count as leaks. The report goes to the app log and returns the number of leaks and bad frees.
+void markAllocations();
+int reportAllocations();
+#endif
@@ -0,0 +1,76 @@
+#include "rollup.hpp"
+
+// dayStart is the offset of local midnight from a multiple of a day in the time() scale.
+Rollup::Rollup(TrackingList const& list, int dayStart) : list(list), dayStart(dayStart) {
+	columns = list.getNodeCapacity() + 1;
+	sums = new int[DAYS * columns]();
+}
+
+Rollup::~Rollup() {
+	delete[] sums;
+}
+
+void Rollup::apply(HistoryEvent const& event) {
+	advance(event.time);
+	switch(event.type) {
+		case HISTORY_START:
+			activeNode = event.node;
+			break;
+		case HISTORY_STOP:
+			activeNode = NULL_V;
+			break;
+		case HISTORY_EDIT:
+			if (event.node != NULL_V)
+				add(event.node, event.value);
+			break;
+		case HISTORY_RESET:
+			break;
+	}
+}
+
+// Credits the accruing node up to the given time, splitting the interval at each midnight.
+void Rollup::advance(int time) {
+	if (firstDay == NULL_V) {
+		firstDay = lastDay = getDay(time);
+		activeSince = time;
+		return;
+	}
+	while (activeNode != NULL_V && activeSince < time) {
+		int day = getDay(activeSince);
+		int end = min(time, (day + 1) * SECONDS_PER_DAY + dayStart);
+		rollTo(day);
+		add(activeNode, end - activeSince);
+		activeSince = end;
+	}
+	rollTo(getDay(time));
+	activeSince = time;
+}
+
+// Seconds of the node, or of all nodes for NULL_V, from the start of the first day to the end of
+// the last one. Days that have dropped out of the window are left out.
+int Rollup::getTime(int node, int first, int last) const {
+	last = min(last, lastDay);
+	first = max(first, lastDay - DAYS + 2);
+	if (firstDay == NULL_V || first > last)
+		return 0;
+	int column = node == NULL_V ? columns - 1 : node;
+	int before = first - 1 < firstDay ? 0 : row(first - 1)[column];
+	return row(last)[column] - before;
+}
+
+// A new day starts from the running sums of the previous one; a clock set back keeps the last day.
+void Rollup::rollTo(int day) {
+	if (day <= lastDay)
+		return;
+	int* previous = row(lastDay);
+	for(int d = max(lastDay + 1, day - DAYS + 1); d <= day; ++d)
+		memmove(row(d), previous, columns * sizeof(int));
+	lastDay = day;
+}
+
+void Rollup::add(int node, int seconds) {
+	int* sum = row(lastDay);
+	for(NodeIndex n = node; n != NULL_V; n = list.getParent(n))
+		sum[n] += seconds;
+	sum[columns - 1] += seconds;
+}
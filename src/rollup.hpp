@@ -0,0 +1,43 @@
+#pragma once
+
+#include "tracker_data.hpp"
+
+// Seconds tracked per node and day over the last days, kept as running sums so that the time of
+// any day range is one subtraction. Time counts toward the node that accrued it and every pair
+// above it in the config, and a last column holds the total over all nodes. Built once from the
+// history log and then fed each new event.
+class Rollup {
+public:
+	Rollup(TrackingList const&, int);
+	~Rollup();
+
+	void apply(HistoryEvent const&);
+	void advance(int);
+
+	int getTime(int, int, int) const;
+	int getDay(int time) const {
+		return (time - dayStart) / SECONDS_PER_DAY;
+	}
+	int getLastDay() const {
+		return lastDay;
+	}
+
+	static const int DAYS = 15;
+	static const int SECONDS_PER_DAY = 24 * 60 * 60;
+
+private:
+	int* row(int day) const {
+		return sums + day % DAYS * columns;
+	}
+	void rollTo(int);
+	void add(int, int);
+
+	TrackingList const& list;
+	int dayStart;
+	int columns;
+	int* sums;
+	int firstDay = NULL_V;
+	int lastDay = NULL_V;
+	int activeNode = NULL_V;
+	int activeSince = 0;
+};
@@ -0,0 +1,65 @@
+#include "string_pool.hpp"
+
+StringPool::StringPool(StringPool const& other) {
+	*this = other;
+}
+
+StringPool& StringPool::operator=(StringPool const& other) {
+	if (this != &other && reserve(other.count, other.length)) {
+		// An empty pool has no buffers yet, and memcpy must not see a null pointer even for 0 bytes.
+		if (other.length > 0)
+			memcpy(chars, other.chars, other.length);
+		if (other.count > 0)
+			memcpy(offsets, other.offsets, other.count * sizeof(uint16_t));
+		count = other.count;
+		length = other.length;
+	}
+	return *this;
+}
+
+StringPool::~StringPool() {
+	free(chars);
+	free(offsets);
+}
+
+NameId StringPool::intern(char const* s) {
+	NameId id = find(s);
+	if (id != NULL_NAME)
+		return id;
+	int size = strlen(s) + 1;
+	if (count + 1 >= NULL_NAME || length + size > UINT16_MAX || !reserve(count + 1, length + size))
+		return NULL_NAME;
+	memcpy(chars + length, s, size);
+	offsets[count] = length;
+	length += size;
+	return count++;
+}
+
+NameId StringPool::find(char const* s) const {
+	for (int i = 0; i < count; ++i) {
+		if (strcmp(chars + offsets[i], s) == 0)
+			return i;
+	}
+	return NULL_NAME;
+}
+
+// Grows both blocks geometrically; names are only added while the config is loaded.
+bool StringPool::reserve(int names, int bytes) {
+	if (names > countCapacity) {
+		int capacity = names > 2 * countCapacity ? names : 2 * countCapacity;
+		uint16_t* grown = (uint16_t*)realloc(offsets, capacity * sizeof(uint16_t));
+		if (!grown)
+			return false;
+		offsets = grown;
+		countCapacity = capacity;
+	}
+	if (bytes > lengthCapacity) {
+		int capacity = bytes > 2 * lengthCapacity ? bytes : 2 * lengthCapacity;
+		char* grown = (char*)realloc(chars, capacity);
+		if (!grown)
+			return false;
+		chars = grown;
+		lengthCapacity = capacity;
+	}
+	return true;
+}
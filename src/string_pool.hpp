@@ -0,0 +1,41 @@
+#pragma once
+
+#include "pebble.hpp"
+
+typedef uint16_t NameId;
+
+#define NULL_NAME ((NameId)0xFFFF)
+
+// Every slot, pair and pair key name in one contiguous block, referred to by a small index.
+// Filled once while the config is loaded; equal strings are stored once.
+class StringPool {
+public:
+	StringPool() {
+	}
+	StringPool(StringPool const&);
+	StringPool& operator=(StringPool const&);
+	~StringPool();
+
+	NameId intern(char const*);
+	NameId find(char const*) const;
+
+	char const* get(NameId id) const {
+		return chars + offsets[id];
+	}
+	int size() const {
+		return count;
+	}
+	int getBytes() const {
+		return length;
+	}
+
+private:
+	bool reserve(int, int);
+
+	char* chars = NULL;
+	uint16_t* offsets = NULL;
+	int count = 0;
+	int countCapacity = 0;
+	int length = 0;
+	int lengthCapacity = 0;
+};
@@ -1,27 +1,86 @@
 #include "tracker_data.hpp"
-
-using namespace std;
+#include "journal.hpp"
+#include "rollup.hpp"
+#include "history_export.hpp"
+#include "config_receiver.hpp"
+#include "diagnostics.hpp"
+#include "alarms.hpp"
 
 const int HEADER_HEIGHT = 18;
-const int MAX_LIST_SIZE = 6;
+const int SCREEN_ROWS = 6;
+const int ROW_CACHE_SIZE = 8;
+const int DEFAULT_LEAVES = 6;
 const int LEFT_MARGIN = 4;
 const int RIGHT_MARGIN = LEFT_MARGIN;
 const int MAX_FREEZE_TIME = 60;
 const int LONG_PRESS_STEP = 3;
-const int RECEIVED_ELEMENTS_KEYMAP = -10;
 const int RECEIVED_HOURS_KEYMAP = 1000;
+const int JOURNAL_KEY = 3000;
+const int CONFIG_KEY = 4000;
+const int HEADER_KEY = 4001;
+const int HISTORY_KEY = 5000;
+const int SAVE_DELAY = 5;
+const int HISTORY_DELAY = 5 * 60;
+const int EXPORT_RETRY_DELAY = 2;
+const int EXPORT_RETRIES = 5;
+
+// What the header showed when the app last saved, so that the first frame can be drawn before the
+// model is loaded. Times keep accruing from the stamp while a slot was active.
+struct HeaderSnapshot {
+	int time;
+	int accTime;
+	int timeStamp;
+	schar mode;
+	bool accruing;
+	bool selected;
+};
 
 static TrackingList* trackingList;
+static schar stateBuffer[PERSIST_DATA_MAX_LENGTH];
+static Journal journal(JOURNAL_KEY);
+static ConfigReceiver configReceiver;
+static AppTimer* saveTimer;
+static int savedRevision;
+static HeaderSnapshot header;
+static bool headerStale;
+static History* history;
+static time_t historyDue;
+static NodeIndex loggedActive;
+static Rollup* rollup;
+static HistoryExport* historyExport;
+static AppTimer* exportTimer;
+static int exportRetries;
+static uint32_t outboxSize;
 
 static Window* window;
 static MenuLayer* menu_layer;
 static GFont status_font;
-static TextLayer* textLayers[MAX_LIST_SIZE][2];
+
+// Formatted times of the rows drawn lately, in the slot of their row modulo the cache size. More
+// rows than the cache holds are never on screen at once.
+struct RowTime {
+	int row;
+	char text[6];
+};
+static RowTime rowTimes[ROW_CACHE_SIZE];
+static bool clockFormatted;
+static bool totalTimeFormatted;
 static bool bluetoothLastState;
 
+static Window* historyWindow;
+static MenuLayer* historyMenu;
+static bool historyWeek;
+// The history entry is a row past the last slot, below the fold until the selection moves there.
+static bool historyEntrySelected;
+
+static Window* diagnosticsWindow;
+static Layer* diagnosticsLayer;
+
+static AppTimer* wakeupTimer;
+static Alarms alarms;
 static time_t freezeTime;
 static int changeTimePos;
-static std::map<int, int> changeTimeAdds;
+static const int changeTimeAdds[] = { 60 * 60, 10 * 60, 1 * 60 };
 
 static const uint32_t tinyDuration[] = {100};
 static VibePattern tinyVibe = { .durations = tinyDuration, .num_segments = 1 };
@@ -29,20 +88,93 @@ static const uint32_t longDurations[] = {400, 200, 500, 200, 500};
 static VibePattern smallVibe = { .durations = longDurations, .num_segments = 1 };
 static VibePattern longVibe = { .durations = longDurations, .num_segments = 3 };
 static VibePattern veryLongVibe = { .durations = longDurations, .num_segments = 5 };
+static const uint32_t goalDurations[] = {150, 100, 150, 100, 150};
+static VibePattern goalVibe = { .durations = goalDurations, .num_segments = 5 };
+static const uint32_t budgetDurations[] = {1000, 300, 1000};
+static VibePattern budgetVibe = { .durations = budgetDurations, .num_segments = 3 };
+static VibePattern* const alarmVibes[ALARM_PATTERNS] = { &smallVibe, &goalVibe, &budgetVibe, &longVibe, &veryLongVibe };
+
+inline void save() {
+	int size = trackingList->serialize(stateBuffer, sizeof(stateBuffer));
+	if (size == 0 || !journal.append(stateBuffer, size))
+		app_log(APP_LOG_LEVEL_WARNING, __FILE__, __LINE__, "state not saved: %d", trackingList->getBinarySize());
+	savedRevision = trackingList->getRevision();
+	headerStale = true;
+}
 
-inline void serialize() {
-	schar* buffer = trackingList->serialize();
-	persist_write_data(0,  buffer, trackingList->getBinarySize());
-	delete[] buffer;
+inline void saveHeader() {
+	header.time = trackingList->totalTime(false);
+	header.accTime = trackingList->totalTime();
+	header.timeStamp = time(0L);
+	header.mode = trackingList->getMode();
+	header.accruing = header.mode == NORMAL_MODE && trackingList->getActiveIndex() != NULL_V;
+	header.selected = trackingList->getSelectedIndex() != NULL_V;
+	persistWrite(HEADER_KEY, &header, sizeof(header));
 }
 
-inline void deserialize() {
+inline void saveConfig() {
+	int size = trackingList->serializeConfig(stateBuffer, sizeof(stateBuffer));
+	if (size == 0 || persistWrite(CONFIG_KEY, stateBuffer, size) < 0)
+		app_log(APP_LOG_LEVEL_WARNING, __FILE__, __LINE__, "config not saved");
+	headerStale = true;
+}
+
+// States saved before the journal existed live in key 0, in the first versions' layout, and key 0
+// held the undo snapshot later on. It is migrated into an empty journal once and then deleted
+// either way, so neither an old state nor a snapshot from before a reset can come back later.
+inline void restore() {
+	int size = journal.load(stateBuffer, sizeof(stateBuffer));
+	bool legacy = size <= 0 && persist_exists(0);
+	if (legacy)
+		size = persist_read_data(0, stateBuffer, sizeof(stateBuffer));
+	if (size > 0 && !(legacy ? trackingList->deserializeLegacy(stateBuffer, size) : trackingList->deserialize(stateBuffer, size)))
+		app_log(APP_LOG_LEVEL_WARNING, __FILE__, __LINE__, "discarded saved state");
 	if (persist_exists(0)) {
-		schar* buffer = new schar[trackingList->getBinarySize()];
-		persist_read_data(0, buffer, trackingList->getBinarySize());
-		trackingList->deserialize(buffer);
-		delete[] buffer;
+		if (legacy)
+			save();
+		persist_delete(0);
 	}
+	savedRevision = trackingList->getRevision();
+}
+
+void handleSave(void*) {
+	++diagnostics.timers;
+	saveTimer = NULL;
+	save();
+}
+
+// Edits are saved a few seconds after they settle; accrual alone needs no save since the next
+// launch replays it from the saved time stamp.
+void scheduleSave() {
+	if (!saveTimer && trackingList->getRevision() != savedRevision)
+		saveTimer = app_timer_register(SAVE_DELAY * 1000, handleSave, NULL);
+}
+
+inline void logEvent(HistoryEventType type, int node, int value) {
+	history->record(type, node, value);
+	if (rollup) {
+		HistoryEvent event = { (int)time(0L), type, node, value };
+		rollup->apply(event);
+	}
+}
+
+// Logs the edits and resets of the last action and any change of the accruing node. The minute
+// tick flushes the log a few minutes after the first new record, so a burst of actions costs one
+// flash write and no wakeup of its own.
+void recordHistory() {
+	for(HistoryEvent const& event : trackingList->getEvents())
+		logEvent(event.type, event.node, event.value);
+	trackingList->clearEvents();
+	NodeIndex active = trackingList->getActiveNode();
+	if (active != loggedActive) {
+		if (active == NULL_V)
+			logEvent(HISTORY_STOP, loggedActive, 0);
+		else
+			logEvent(HISTORY_START, active, 0);
+		loggedActive = active;
+	}
+	if (history->hasPending() && !historyDue)
+		historyDue = time(0L) + HISTORY_DELAY;
 }
 
 inline GFont getFont(bool big, bool selected) {
@@ -52,28 +184,76 @@ inline GFont getFont(bool big, bool selected) {
 }
 
 uint16_t getNumRows(MenuLayer* menu_layer, uint16_t cell_index, void*) {
+	return trackingList ? trackingList->size() + 1 : 0;
+}
+
+uint16_t getHistoryNumRows(MenuLayer* menu_layer, uint16_t cell_index, void*) {
 	return trackingList->size();
 }
 
+inline bool isHistoryEntry(int row) {
+	return row == trackingList->size();
+}
+
+// Up to a screenful of leaves the rows share the screen by height. Past that every row is one leaf
+// high and the menu scrolls, drawing only the rows in view.
+inline bool rowsScroll() {
+	return trackingList->totalHeight() > SCREEN_ROWS;
+}
+
+inline bool isBigRow(int row) {
+	return trackingList->at(row)->getHeight() > 1 && !rowsScroll();
+}
+
 int16_t getCellHeight(MenuLayer* menu_layer, MenuIndex* cell_index, void*) {
-	int16_t baseHeight = (layer_get_bounds(menu_layer_get_layer(menu_layer)).size.h - HEADER_HEIGHT) / trackingList->totalHeight();
-	return trackingList->at(cell_index->row)->getHeight() * baseHeight;
+	int16_t screenHeight = layer_get_bounds(menu_layer_get_layer(menu_layer)).size.h - HEADER_HEIGHT;
+	if (rowsScroll() || isHistoryEntry(cell_index->row))
+		return screenHeight / SCREEN_ROWS;
+	return trackingList->at(cell_index->row)->getHeight() * (screenHeight / trackingList->totalHeight());
+}
+
+inline void clearRowTimes() {
+	for(RowTime& rowTime : rowTimes)
+		rowTime.row = NULL_V;
 }
 
 int16_t getHeaderHeight(MenuLayer* menu_layer, uint16_t section_index, void*) {
 	return HEADER_HEIGHT;
 }
 
+inline void countDraw(uint32_t start) {
+	++diagnostics.draws;
+	diagnostics.drawMs += getClockMs() - start;
+}
+
+void drawHistoryEntry(GContext* ctx, const Layer* cell_layer) {
+	GRect bounds = layer_get_bounds(cell_layer);
+	GRect nameBounds = { LEFT_MARGIN, 0, bounds.size.w - LEFT_MARGIN - RIGHT_MARGIN, bounds.size.h };
+	graphics_context_set_fill_color(ctx, historyEntrySelected ? GColorJaegerGreen : GColorIslamicGreen);
+	graphics_fill_rect(ctx, bounds, 0, GCornersAll);
+	graphics_context_set_text_color(ctx, GColorBlack);
+	graphics_draw_text(ctx, "history", getFont(false, historyEntrySelected), nameBounds, GTextOverflowModeFill, GTextAlignmentLeft, NULL);
+}
+
 void drawRow(GContext* ctx, const Layer* cell_layer, MenuIndex* cell_index, void*) {
+	uint32_t drawStart = getClockMs();
 	int row = cell_index->row;
-	int selIndex = trackingList->getSelectedIndex();
-	bool isBig = trackingList->at(row)->getHeight() > 1;
+	if (isHistoryEntry(row)) {
+		drawHistoryEntry(ctx, cell_layer);
+		countDraw(drawStart);
+		return;
+	}
+	int selIndex = historyEntrySelected ? NULL_V : trackingList->getSelectedIndex();
+	bool isBig = isBigRow(row);
 	TrackingListMode mode = trackingList->getMode();
-	char const* name = trackingList->at(row)->getName();
+	char const* name = trackingList->getName(row);
 	bool isActive = trackingList->getActiveIndex() == row;
-	int timeInSecs = trackingList->at(row)->getTime();
-	static char time[MAX_LIST_SIZE][6];
-	snprintf(time[row], sizeof(time[row]), "%d:%02d", timeInSecs / (60 * 60), timeInSecs / 60 % 60);
+	RowTime& rowTime = rowTimes[row % ROW_CACHE_SIZE];
+	if (rowTime.row != row) {
+		int timeInSecs = trackingList->at(row)->getTime();
+		snprintf(rowTime.text, sizeof(rowTime.text), "%d:%02d", timeInSecs / (60 * 60), timeInSecs / 60 % 60);
+		rowTime.row = row;
+	}
 
 	GRect bounds = layer_get_bounds(cell_layer);
 	GRect nameBounds = { LEFT_MARGIN, 0, bounds.size.w * 2 / 3 - LEFT_MARGIN, bounds.size.h };
@@ -108,24 +288,44 @@ void drawRow(GContext* ctx, const Layer* cell_layer, MenuIndex* cell_index, void
 	else {
 		timeFont = nameFont;
 	}
-	graphics_draw_text(ctx, time[row], timeFont, timeBounds, GTextOverflowModeFill, GTextAlignmentRight, NULL);
+	graphics_draw_text(ctx, rowTime.text, timeFont, timeBounds, GTextOverflowModeFill, GTextAlignmentRight, NULL);
+	countDraw(drawStart);
 }
 
 void drawHeader(GContext* ctx, const Layer* cell_layer, uint16_t, void*) {
-	int selIndex = trackingList->getSelectedIndex();
-	TrackingListMode mode = trackingList->getMode();
-	time_t t = time(0L);
-	struct tm* now = localtime(&t);
-	static char time[6];
-	snprintf(time, sizeof(time), "%d:%02d", now->tm_hour, now->tm_min);
-	int timeInSecs = trackingList->totalTime(false);
-	int accTimeInSecs = trackingList->totalTime();
+	uint32_t drawStart = getClockMs();
+	int selIndex;
+	TrackingListMode mode;
+	int timeInSecs, accTimeInSecs;
+	if (trackingList) {
+		selIndex = trackingList->getSelectedIndex();
+		mode = trackingList->getMode();
+		timeInSecs = trackingList->totalTime(false);
+		accTimeInSecs = trackingList->totalTime();
+	}
+	else {
+		int accrued = header.accruing ? max(0, (int)time(0L) - header.timeStamp) : 0;
+		selIndex = header.selected ? 0 : NULL_V;
+		mode = (TrackingListMode)header.mode;
+		timeInSecs = header.time + accrued;
+		accTimeInSecs = header.accTime + accrued;
+	}
+	static char currentTime[6];
+	if (!clockFormatted) {
+		time_t t = time(0L);
+		struct tm* now = localtime(&t);
+		snprintf(currentTime, sizeof(currentTime), "%d:%02d", now->tm_hour, now->tm_min);
+		clockFormatted = true;
+	}
 	static char totalTime[13];
-	if (timeInSecs != accTimeInSecs || mode == FREEZE_MODE)
-		snprintf(totalTime, sizeof(totalTime), "%d:%02d/%d:%02d", timeInSecs / (60 * 60), timeInSecs / 60 % 60,
-									  accTimeInSecs / (60 * 60), accTimeInSecs / 60 % 60);
-	else
-		snprintf(totalTime, sizeof(totalTime), "%d:%02d", timeInSecs / (60 * 60), timeInSecs / 60 % 60);
+	if (!totalTimeFormatted) {
+		if (timeInSecs != accTimeInSecs || mode == FREEZE_MODE)
+			snprintf(totalTime, sizeof(totalTime), "%d:%02d/%d:%02d", timeInSecs / (60 * 60), timeInSecs / 60 % 60,
+										  accTimeInSecs / (60 * 60), accTimeInSecs / 60 % 60);
+		else
+			snprintf(totalTime, sizeof(totalTime), "%d:%02d", timeInSecs / (60 * 60), timeInSecs / 60 % 60);
+		totalTimeFormatted = true;
+	}
 
 	GRect bounds = layer_get_bounds(cell_layer);
 	GRect timeBounds = { LEFT_MARGIN, 0, bounds.size.w / 4 - LEFT_MARGIN, bounds.size.h };
@@ -137,7 +337,7 @@ void drawHeader(GContext* ctx, const Layer* cell_layer, uint16_t, void*) {
 		graphics_context_set_fill_color(ctx, selIndex != NULL_V ? GColorPictonBlue : GColorBlueMoon);
 	graphics_fill_rect(ctx, bounds, 0, GCornersAll);
 	graphics_draw_line(ctx, GPoint(0, bounds.size.h - 1), GPoint(bounds.size.w, bounds.size.h - 1));
-	graphics_draw_text(ctx, time, status_font, timeBounds, GTextOverflowModeFill, GTextAlignmentLeft, NULL);
+	graphics_draw_text(ctx, currentTime, status_font, timeBounds, GTextOverflowModeFill, GTextAlignmentLeft, NULL);
 
 	if (mode == FREEZE_MODE && selIndex == NULL_V) {
 		int digitShiftX = 83;
@@ -154,9 +354,101 @@ void drawHeader(GContext* ctx, const Layer* cell_layer, uint16_t, void*) {
 					GPoint(totalTimeBounds.origin.x + digitShiftX + digitWidth, digitShiftY));
 	}
 	graphics_draw_text(ctx, totalTime, status_font, totalTimeBounds, GTextOverflowModeFill, GTextAlignmentRight, NULL);
+	countDraw(drawStart);
+}
+
+// Reloads the menu only when merges, splits or a restore replaced the rows. Otherwise it is just
+// redrawn, and only the rows and header fields the list reports as changed are formatted again.
+// A redraw that keeps none of the formatted rows counts as full.
+void refresh() {
+	if (trackingList->layoutChanged()) {
+		clearRowTimes();
+		totalTimeFormatted = false;
+		menu_layer_reload_data(menu_layer);
+		++diagnostics.reloads;
+		++diagnostics.fullRedraws;
+	}
+	else {
+		bool full = true;
+		for(RowTime& rowTime : rowTimes) {
+			if (rowTime.row != NULL_V && trackingList->rowChanged(rowTime.row))
+				rowTime.row = NULL_V;
+			else if (rowTime.row != NULL_V)
+				full = false;
+		}
+		if (trackingList->headerChanged())
+			totalTimeFormatted = false;
+		layer_mark_dirty(menu_layer_get_layer(menu_layer));
+		++(full ? diagnostics.fullRedraws : diagnostics.partialRedraws);
+	}
+	trackingList->clearChanges();
+	if (trackingList->getMode() != FREEZE_MODE)
+		trackingList->endStep();
+}
+
+void handleWakeup(void*);
+
+// Wakes only for the moments that matter: the next minute rollover of the active slot (so its time
+// is shown when it turns), the next alarm deadline and the end of time editing. Deadlines are planned
+// again only when the list changed. The header clock is kept by the minute tick.
+void scheduleWakeup() {
+	int delay = NULL_V;
+	int elementTime = trackingList->updateTime();
+	if (elementTime != NULL_V)
+		delay = 60 - elementTime % 60;
+	if (!alarms.isPlanned(*trackingList))
+		alarms.plan(*trackingList, time(0L));
+	int deadline = alarms.getNextDeadline();
+	if (deadline != NULL_V) {
+		int alarmDelay = max(0, deadline - (int)time(0L));
+		delay = delay == NULL_V ? alarmDelay : min(delay, alarmDelay);
+	}
+	if (trackingList->getMode() == FREEZE_MODE) {
+		int freezeDelay = max(0, (int)(freezeTime + MAX_FREEZE_TIME - time(0L)));
+		delay = delay == NULL_V ? freezeDelay : min(delay, freezeDelay);
+	}
+
+	if (delay == NULL_V) {
+		if (wakeupTimer)
+			app_timer_cancel(wakeupTimer);
+		wakeupTimer = NULL;
+	}
+	else if (!wakeupTimer || !app_timer_reschedule(wakeupTimer, delay * 1000)) {
+		wakeupTimer = app_timer_register(delay * 1000, handleWakeup, NULL);
+	}
+	recordHistory();
+	scheduleSave();
+}
+
+void handleWakeup(void*) {
+	++diagnostics.timers;
+	wakeupTimer = NULL;
+	trackingList->updateTime();
+	int pattern = alarms.fire(time(0L));
+	if (pattern != NULL_V)
+		vibes_enqueue_custom_pattern(*alarmVibes[pattern]);
+
+	if (trackingList->getMode() == FREEZE_MODE && time(0L) - freezeTime >= MAX_FREEZE_TIME)
+		trackingList->switchMode(NORMAL_MODE);
+	scheduleWakeup();
+	refresh();
+}
+
+// The menu clamps a selection past its rows to the last one, the history entry, so the header
+// scrolls to the top instead.
+inline void showSelected() {
+	int selIndex = trackingList->getSelectedIndex();
+	menu_layer_set_selected_index(menu_layer, MenuIndex(0, selIndex == NULL_V ? 0 : selIndex), MenuRowAlignNone, true);
 }
 
 void backClick(ClickRecognizerRef, void*) {
+	if (historyEntrySelected) {
+		historyEntrySelected = false;
+		trackingList->resetIndex();
+		showSelected();
+		refresh();
+		return;
+	}
 	int selIndex = trackingList->getSelectedIndex();
 	switch(trackingList->getMode()) {
 		case FREEZE_MODE:
@@ -189,10 +481,17 @@ void backClick(ClickRecognizerRef, void*) {
 			}
 			break;
 	}
-	menu_layer_reload_data(menu_layer);
+	scheduleWakeup();
+	refresh();
 }
 
+void openHistory();
+
 void selectClick(ClickRecognizerRef c, void*) {
+	if (historyEntrySelected) {
+		openHistory();
+		return;
+	}
 	TrackingListMode mode = trackingList->getMode();
 	int selIndex = trackingList->getSelectedIndex();
 	switch(mode) {
@@ -222,21 +521,21 @@ void selectClick(ClickRecognizerRef c, void*) {
 			}
 			break;
 	}
-	menu_layer_reload_data(menu_layer);
+	scheduleWakeup();
+	refresh();
 }
 
 void longSelectClick(ClickRecognizerRef, void*) {
+	if (historyEntrySelected)
+		return;
 	int selIndex = trackingList->getSelectedIndex();
 	switch(trackingList->getMode()) {
 		case NORMAL_MODE:
 			if (selIndex == NULL_V) {
-				if (trackingList->totalTime(false) != 0) {
-					serialize();
+				if (trackingList->totalTime(false) != 0)
 					trackingList->resetTime(false);
-				}
-				else {
-					deserialize();
-				}
+				else
+					trackingList->undo();
 			}
 			else {
 				trackingList->switchMode(FREEZE_MODE);
@@ -256,22 +555,21 @@ void longSelectClick(ClickRecognizerRef, void*) {
 			trackingList->switchMode(NORMAL_MODE);
 			break;
 	}
-	menu_layer_reload_data(menu_layer);
+	scheduleWakeup();
+	refresh();
 }
 
 static void longUpClick(ClickRecognizerRef, void*) {
+	if (historyEntrySelected)
+		return;
 	int selIndex = trackingList->getSelectedIndex();
 	switch(trackingList->getMode()) {
 		case NORMAL_MODE:
 			if (selIndex == NULL_V) {
-				if (trackingList->totalTime() != 0) {
-					if(trackingList->totalTime(false) != 0)
-						serialize();
+				if (trackingList->totalTime() != 0)
 					trackingList->resetTime(true);
-				}
-				else {
-					deserialize();
-				}
+				else
+					trackingList->undo();
 			}
 			else if (trackingList->getPreviousActiveIndex() != NULL_V && selIndex < LONG_PRESS_STEP) {
 				trackingList->restorePreviousActive();
@@ -300,29 +598,39 @@ static void longUpClick(ClickRecognizerRef, void*) {
 						trackingList->addTime(changeTimeAdds[changeTimePos] * 5);
 						break;
 				}
-				menu_layer_reload_data(menu_layer);
+				scheduleWakeup();
+				refresh();
 				return;
 			}
 			trackingList->decIndex();
 			break;
 
 	}
-	menu_layer_set_selected_index(menu_layer, MenuIndex(0, trackingList->getSelectedIndex()), MenuRowAlignNone, true);
+	scheduleWakeup();
+	refresh();
+	showSelected();
 }
 
 static void upClick(ClickRecognizerRef, void*) {
-	if (trackingList->getMode() != FREEZE_MODE) {
+	if (historyEntrySelected) {
+		historyEntrySelected = false;
+		showSelected();
+	}
+	else if (trackingList->getMode() != FREEZE_MODE) {
 		trackingList->decIndex();
-		menu_layer_set_selected_index(menu_layer, MenuIndex(0, trackingList->getSelectedIndex()), MenuRowAlignNone, true);
+		showSelected();
 	}
 	else {
 		trackingList->addTime(changeTimeAdds[changeTimePos]);
 		freezeTime = time(0L);
-		menu_layer_reload_data(menu_layer);
+		scheduleWakeup();
+		refresh();
 	}
 }
 
 static void longDownClick(ClickRecognizerRef, void*) {
+	if (historyEntrySelected)
+		return;
 	int selIndex = trackingList->getSelectedIndex();
 	TrackingListMode mode = trackingList->getMode();
 	switch(trackingList->getMode()) {
@@ -359,53 +667,63 @@ static void longDownClick(ClickRecognizerRef, void*) {
 						trackingList->subTime(changeTimeAdds[changeTimePos] * 5);
 						break;
 				}
-				menu_layer_reload_data(menu_layer);
+				scheduleWakeup();
+				refresh();
 				return;
 			}
 			trackingList->incIndex();
 			break;
 	}
-	menu_layer_set_selected_index(menu_layer, MenuIndex(0, trackingList->getSelectedIndex()), MenuRowAlignNone, true);
+	scheduleWakeup();
+	refresh();
+	showSelected();
 }
 
+// In normal mode down goes from the last slot to the history entry and from there to the first.
 static void downClick(ClickRecognizerRef, void*) {
-	if (trackingList->getMode() != FREEZE_MODE) {
+	if (!historyEntrySelected && trackingList->getMode() == NORMAL_MODE && trackingList->getSelectedIndex() == trackingList->size() - 1) {
+		historyEntrySelected = true;
+		menu_layer_set_selected_index(menu_layer, MenuIndex(0, trackingList->size()), MenuRowAlignNone, true);
+	}
+	else if (trackingList->getMode() != FREEZE_MODE) {
+		historyEntrySelected = false;
 		trackingList->incIndex();
-		menu_layer_set_selected_index(menu_layer, MenuIndex(0, trackingList->getSelectedIndex()), MenuRowAlignNone, true);
+		showSelected();
 	}
 	else {
 		trackingList->subTime(changeTimeAdds[changeTimePos]);
 		freezeTime = time(0L);
-		menu_layer_reload_data(menu_layer);
+		scheduleWakeup();
+		refresh();
 	}
 }
 
+void sendExport();
+
 void handleBluetooth(bool connected) {
 	if (connected != bluetoothLastState)
 		vibes_short_pulse();
 	bluetoothLastState = connected;
+	if (connected && historyExport && !exportTimer)
+		sendExport();
 }
 
 void handleTick(tm* tickTime, TimeUnits units) {
-	int elementTime = trackingList->updateTime();
-	bool elementMinuteChanged = elementTime % 60 == 0 && elementTime > 0;
-	if (units & MINUTE_UNIT || elementMinuteChanged) {
-		if (elementMinuteChanged) {
-			int accTimeInSecs = trackingList->totalTime();
-			int timeInSecs = trackingList->totalTime(false);
-			if (accTimeInSecs > 60 && accTimeInSecs / 60 % (trackingList->getTotalAccHours() * 60) == 0)
-				vibes_enqueue_custom_pattern(veryLongVibe);
-			else if (timeInSecs > 60 && (timeInSecs / 60 % (trackingList->getTotalHours() * 60) == 0 ||
-						     accTimeInSecs / 60 % (trackingList->getTotalHours() * 60) == 0))
-				vibes_enqueue_custom_pattern(longVibe);
-			else if (elementTime % (60 * 60) == 0)
-				vibes_enqueue_custom_pattern(smallVibe);
-		}
-
-		if (trackingList->getMode() == FREEZE_MODE && mktime(tickTime) - freezeTime >= MAX_FREEZE_TIME)
-			trackingList->switchMode(NORMAL_MODE);
-		menu_layer_reload_data(menu_layer);
+	++diagnostics.ticks;
+	sampleHeap();
+	if (historyDue && time(0L) >= historyDue) {
+		history->flush();
+		historyDue = 0;
+	}
+	trackingList->updateTime();
+	clockFormatted = false;
+	refresh();
+	if (historyMenu) {
+		rollup->advance(time(0L));
+		layer_mark_dirty(menu_layer_get_layer(historyMenu));
 	}
+	if (diagnosticsLayer)
+		layer_mark_dirty(diagnosticsLayer);
 }
 
 static void window_load(Window* window) {
@@ -424,6 +742,9 @@ static void window_load(Window* window) {
 	menuLayerCallbacks.draw_row = drawRow;
 	menuLayerCallbacks.draw_header = drawHeader;
 	menu_layer_set_callbacks(menu_layer, trackingList, menuLayerCallbacks);
+	clearRowTimes();
+	historyEntrySelected = false;
+	clockFormatted = totalTimeFormatted = false;
 
 	layer_add_child(window_layer, menu_layer_get_layer(menu_layer));
 }
@@ -442,57 +763,314 @@ static void click_config_provider(void*) {
 	window_long_click_subscribe(BUTTON_ID_DOWN, 300, longDownClick, NULL);
 }
 
-static void handle_msg_received(DictionaryIterator *received, void*) {
-	Tuple* tuple;
-	PairMap pairs;
-	for(auto i = 1; (tuple = dict_find(received, 2 * i - 1)) != NULL || persist_exists(2 * i - 1); ++i) {
-		if (tuple) {
-			char* key = (char*)tuple->value;
-			char* title = (char*)dict_find(received, 2 * i)->value;
-			app_log(APP_LOG_LEVEL_DEBUG, __FILE__, __LINE__, "%s: %s", key, title);
-			pairs.insert(pair<char*, char*>(key, title));
-
-			persist_write_string(2 * i - 1, key);
-			persist_write_string(2 * i, title);
-		}
-		else {
-			persist_delete(2 * i - 1);
-			persist_delete(2 * i);
-		}
+// The history view shows the rows of the list with their time today or this week, read from the
+// rollup, which is built from the log the first time the view opens.
+inline int historyFirstDay() {
+	int today = rollup->getDay(time(0L));
+	return historyWeek ? today - (today + 3) % 7 : today;
+}
+
+void drawHistoryRow(GContext* ctx, const Layer* cell_layer, MenuIndex* cell_index, void*) {
+	uint32_t drawStart = getClockMs();
+	int row = cell_index->row;
+	bool isBig = isBigRow(row);
+	int timeInSecs = rollup->getTime(trackingList->getNode(row), historyFirstDay(), rollup->getLastDay());
+	char rowTime[8];
+	snprintf(rowTime, sizeof(rowTime), "%d:%02d", timeInSecs / (60 * 60), timeInSecs / 60 % 60);
+
+	GRect bounds = layer_get_bounds(cell_layer);
+	GRect nameBounds = { LEFT_MARGIN, 0, bounds.size.w * 2 / 3 - LEFT_MARGIN, bounds.size.h };
+	GRect timeBounds = { bounds.size.w * 2 / 3, 0, bounds.size.w / 3 - RIGHT_MARGIN, bounds.size.h };
+	graphics_context_set_fill_color(ctx, row % 2 == 1 ? GColorRajah : GColorPastelYellow);
+	graphics_fill_rect(ctx, bounds, 0, GCornersAll);
+	graphics_context_set_text_color(ctx, GColorBlack);
+	GFont font = getFont(isBig, false);
+	graphics_draw_text(ctx, trackingList->getName(row), font, nameBounds, GTextOverflowModeFill, GTextAlignmentLeft, NULL);
+	graphics_draw_text(ctx, rowTime, font, timeBounds, GTextOverflowModeFill, GTextAlignmentRight, NULL);
+	countDraw(drawStart);
+}
+
+void drawHistoryHeader(GContext* ctx, const Layer* cell_layer, uint16_t, void*) {
+	uint32_t drawStart = getClockMs();
+	int timeInSecs = rollup->getTime(NULL_V, historyFirstDay(), rollup->getLastDay());
+	char totalTime[8];
+	snprintf(totalTime, sizeof(totalTime), "%d:%02d", timeInSecs / (60 * 60), timeInSecs / 60 % 60);
+
+	GRect bounds = layer_get_bounds(cell_layer);
+	GRect labelBounds = { LEFT_MARGIN, 0, bounds.size.w / 2 - LEFT_MARGIN, bounds.size.h };
+	GRect totalTimeBounds = { bounds.size.w / 2, 0, bounds.size.w / 2 - RIGHT_MARGIN, bounds.size.h };
+	graphics_context_set_fill_color(ctx, GColorIslamicGreen);
+	graphics_fill_rect(ctx, bounds, 0, GCornersAll);
+	graphics_draw_line(ctx, GPoint(0, bounds.size.h - 1), GPoint(bounds.size.w, bounds.size.h - 1));
+	graphics_draw_text(ctx, historyWeek ? "week" : "today", status_font, labelBounds, GTextOverflowModeFill, GTextAlignmentLeft, NULL);
+	graphics_draw_text(ctx, totalTime, status_font, totalTimeBounds, GTextOverflowModeFill, GTextAlignmentRight, NULL);
+	countDraw(drawStart);
+}
+
+inline void stopExport() {
+	if (exportTimer)
+		app_timer_cancel(exportTimer);
+	exportTimer = NULL;
+	delete historyExport;
+	historyExport = NULL;
+}
+
+void handleExportRetry(void*) {
+	++diagnostics.timers;
+	exportTimer = NULL;
+	sendExport();
+}
+
+void retryExport(AppMessageResult reason) {
+	if (++exportRetries > EXPORT_RETRIES) {
+		app_log(APP_LOG_LEVEL_WARNING, __FILE__, __LINE__, "export failed: %d", reason);
+		stopExport();
+		return;
+	}
+	exportTimer = app_timer_register(EXPORT_RETRY_DELAY * 1000, handleExportRetry, NULL);
+}
+
+// Each chunk goes out as soon as the previous one is acknowledged. AppMessage has one message in
+// flight, so that keeps the link busy. A dropped link resumes from the unacknowledged chunk once
+// it is back; other failures, a busy outbox among them, are retried a few times.
+void sendExport() {
+	DictionaryIterator* iter;
+	AppMessageResult result = app_message_outbox_begin(&iter);
+	if (result != APP_MSG_OK) {
+		retryExport(result);
+		return;
+	}
+	if (!historyExport->write(iter)) {
+		app_log(APP_LOG_LEVEL_WARNING, __FILE__, __LINE__, "export chunk %d does not fit", historyExport->getChunk());
+		stopExport();
+		return;
 	}
+	app_message_outbox_send();
+}
 
-	vector<BaseTracking*> elements;
-	for(auto i = -1; (tuple = dict_find(received, RECEIVED_ELEMENTS_KEYMAP * (2 * i + 1))) != NULL || persist_exists(2 * i + 1); --i) {
-		if (tuple) {
-			char* title = (char*)tuple->value;
-			int* priority = (int*)dict_find(received, RECEIVED_ELEMENTS_KEYMAP * 2 * i)->value;
-			app_log(APP_LOG_LEVEL_DEBUG, __FILE__, __LINE__, "%s: %d", title, *priority);
-			elements.push_back(new TrackingElement(title, *priority));
+// Diagnostics share the outbox, so only the export's own chunks move it on.
+static bool isExportChunk(DictionaryIterator* iter) {
+	return dict_find(iter, HistoryExport::CHUNK_KEY) != NULL;
+}
 
-			persist_write_string(2 * i + 1, title);
-			persist_write_int(2 * i, *priority);
-		}
-		else {
-			persist_delete(2 * i + 1);
-			persist_delete(2 * i);
-		}
+void handleOutboxSent(DictionaryIterator* sent, void*) {
+	diagnostics.messageBytesOut += getMessageSize(sent);
+	if (!historyExport || !isExportChunk(sent))
+		return;
+	exportRetries = 0;
+	historyExport->acknowledge();
+	if (historyExport->isDone())
+		stopExport();
+	else
+		sendExport();
+}
+
+void handleOutboxFailed(DictionaryIterator* failed, AppMessageResult reason, void*) {
+	diagnostics.messageBytesOut += getMessageSize(failed);
+	if (!historyExport || !isExportChunk(failed) || reason == APP_MSG_NOT_CONNECTED)
+		return;
+	retryExport(reason);
+}
+
+static void historyExportClick(ClickRecognizerRef, void*) {
+	if (historyExport)
+		return;
+	historyExport = new HistoryExport(*history, *trackingList, outboxSize);
+	exportRetries = 0;
+	sendExport();
+}
+
+static void historyRangeClick(ClickRecognizerRef, void*) {
+	historyWeek = !historyWeek;
+	layer_mark_dirty(menu_layer_get_layer(historyMenu));
+}
+
+static void historyCloseClick(ClickRecognizerRef, void*) {
+	window_stack_pop(true);
+}
+
+// The history rows are the list's rows, so they show at once what an undo or redo brought back.
+static void replayStep(bool redo) {
+	if (!(redo ? trackingList->redo() : trackingList->undo())) {
+		vibes_short_pulse();
+		return;
+	}
+	scheduleWakeup();
+	refresh();
+	menu_layer_reload_data(historyMenu);
+	++diagnostics.reloads;
+}
+
+static void historyUndoClick(ClickRecognizerRef, void*) {
+	replayStep(false);
+}
+
+static void historyRedoClick(ClickRecognizerRef, void*) {
+	replayStep(true);
+}
+
+// The diagnostics window opens on select in the history view. It shows the counters as of the last
+// minute tick and sends them to the phone on a long select.
+void drawDiagnostics(Layer* layer, GContext* ctx) {
+	GRect bounds = layer_get_bounds(layer);
+	int lineHeight = bounds.size.h / Diagnostics::COUNTERS;
+	char value[12];
+	graphics_context_set_text_color(ctx, GColorBlack);
+	for (int i = 0; i < Diagnostics::COUNTERS; ++i) {
+		GRect nameBounds = { LEFT_MARGIN, i * lineHeight, bounds.size.w * 2 / 3 - LEFT_MARGIN, lineHeight };
+		GRect valueBounds = { bounds.size.w * 2 / 3, i * lineHeight, bounds.size.w / 3 - RIGHT_MARGIN, lineHeight };
+		snprintf(value, sizeof(value), "%lu", (unsigned long)diagnostics.getValue(i));
+		graphics_draw_text(ctx, Diagnostics::getName(i), status_font, nameBounds, GTextOverflowModeFill, GTextAlignmentLeft, NULL);
+		graphics_draw_text(ctx, value, status_font, valueBounds, GTextOverflowModeFill, GTextAlignmentRight, NULL);
 	}
+}
 
-	int* totalHours = (int*)dict_find(received, RECEIVED_HOURS_KEYMAP * 1)->value;
-	persist_write_int(RECEIVED_HOURS_KEYMAP * 1, *totalHours);
-	app_log(APP_LOG_LEVEL_DEBUG, __FILE__, __LINE__, "total hours: %d", *totalHours);
-	int* accTotalHours = (int*)dict_find(received, RECEIVED_HOURS_KEYMAP * 2)->value;
-	persist_write_int(RECEIVED_HOURS_KEYMAP * 2, *accTotalHours);
-	app_log(APP_LOG_LEVEL_DEBUG, __FILE__, __LINE__, "total accumulated hours: %d", *accTotalHours);
+static void diagnosticsSendClick(ClickRecognizerRef, void*) {
+	DictionaryIterator* iter;
+	if (app_message_outbox_begin(&iter) != APP_MSG_OK)
+		return;
+	if (!diagnostics.write(iter))
+		app_log(APP_LOG_LEVEL_WARNING, __FILE__, __LINE__, "diagnostics do not fit");
+	app_message_outbox_send();
+}
+
+static void diagnosticsCloseClick(ClickRecognizerRef, void*) {
+	window_stack_pop(true);
+}
+
+#ifdef TRACKER_PROFILE_ALLOCATIONS
+// Long up marks the blocks live so far as expected, long down writes the profile to the app log.
+static void allocationsMarkClick(ClickRecognizerRef, void*) {
+	markAllocations();
+}
+
+static void allocationsReportClick(ClickRecognizerRef, void*) {
+	reportAllocations();
+}
+#endif
 
+static void diagnostics_click_config_provider(void*) {
+	window_single_click_subscribe(BUTTON_ID_BACK, diagnosticsCloseClick);
+	window_single_click_subscribe(BUTTON_ID_SELECT, diagnosticsCloseClick);
+	window_long_click_subscribe(BUTTON_ID_SELECT, 500, diagnosticsSendClick, NULL);
+#ifdef TRACKER_PROFILE_ALLOCATIONS
+	window_long_click_subscribe(BUTTON_ID_UP, 500, allocationsMarkClick, NULL);
+	window_long_click_subscribe(BUTTON_ID_DOWN, 500, allocationsReportClick, NULL);
+#endif
+}
+
+static void diagnostics_window_load(Window* window) {
+	Layer* window_layer = window_get_root_layer(window);
+	diagnosticsLayer = layer_create(layer_get_bounds(window_layer));
+	layer_set_update_proc(diagnosticsLayer, drawDiagnostics);
+	layer_add_child(window_layer, diagnosticsLayer);
+}
+
+static void diagnostics_window_unload(Window* window) {
+	layer_destroy(diagnosticsLayer);
+	diagnosticsLayer = NULL;
+}
+
+static void diagnosticsOpenClick(ClickRecognizerRef, void*) {
+	sampleHeap();
+	window_stack_push(diagnosticsWindow, true);
+}
+
+static void history_click_config_provider(void*) {
+	window_single_click_subscribe(BUTTON_ID_BACK, historyCloseClick);
+	window_single_click_subscribe(BUTTON_ID_SELECT, diagnosticsOpenClick);
+	window_long_click_subscribe(BUTTON_ID_SELECT, 500, historyExportClick, NULL);
+	window_single_click_subscribe(BUTTON_ID_UP, historyRangeClick);
+	window_single_click_subscribe(BUTTON_ID_DOWN, historyRangeClick);
+	window_long_click_subscribe(BUTTON_ID_UP, 500, historyUndoClick, NULL);
+	window_long_click_subscribe(BUTTON_ID_DOWN, 500, historyRedoClick, NULL);
+}
+
+static void history_window_load(Window* window) {
+	Layer* window_layer = window_get_root_layer(window);
+	GRect bounds = layer_get_bounds(window_layer);
+
+	historyMenu = menu_layer_create((GRect) {
+		.origin = GPointZero,
+		.size = bounds.size
+	});
+
+	static MenuLayerCallbacks menuLayerCallbacks;
+	menuLayerCallbacks.get_num_rows = getHistoryNumRows;
+	menuLayerCallbacks.get_cell_height = getCellHeight;
+	menuLayerCallbacks.get_header_height = getHeaderHeight;
+	menuLayerCallbacks.draw_row = drawHistoryRow;
+	menuLayerCallbacks.draw_header = drawHistoryHeader;
+	menu_layer_set_callbacks(historyMenu, NULL, menuLayerCallbacks);
+
+	layer_add_child(window_layer, menu_layer_get_layer(historyMenu));
+}
+
+static void history_window_unload(Window* window) {
+	menu_layer_destroy(historyMenu);
+	historyMenu = NULL;
+}
+
+void buildRollup() {
+	rollup = new Rollup(*trackingList, time_start_of_today() % Rollup::SECONDS_PER_DAY);
+	HistoryReader reader(*history);
+	HistoryEvent event;
+	while (reader.next(event))
+		rollup->apply(event);
+	rollup->advance(time(0L));
+}
+
+void openHistory() {
+	if (!rollup)
+		buildRollup();
+	else
+		rollup->advance(time(0L));
+	historyWeek = false;
+	window_stack_push(historyWindow, true);
+}
+
+// A new config takes over the times of the list it replaces. Saving it is the config key and one
+// journal write; the history is dropped only when node slots moved. Undo starts over either way.
+static void handle_msg_received(DictionaryIterator *received, void*) {
+	diagnostics.messageBytesIn += getMessageSize(received);
+	if (!configReceiver.receive(received) || !configReceiver.isComplete())
+		return;
+	TrackingList* list = TrackingList::fromConfig((schar const*)configReceiver.getData(), configReceiver.getSize());
+	configReceiver.reset();
+	if (!list) {
+		app_log(APP_LOG_LEVEL_WARNING, __FILE__, __LINE__, "discarded received config");
+		return;
+	}
+	stopExport();
+	recordHistory();
+	bool sameNodes = list->carryOver(*trackingList);
 	delete trackingList;
-	trackingList = new TrackingList(elements, pairs, *totalHours, *accTotalHours);
-	persist_delete(0);
+	trackingList = list;
+	alarms.clear();
+	historyEntrySelected = false;
+	delete rollup;
+	rollup = NULL;
+	if (!sameNodes) {
+		history->clear();
+		loggedActive = NULL_V;
+	}
+	// An open history view shows the new rows at once.
+	if (historyMenu) {
+		buildRollup();
+		menu_layer_reload_data(historyMenu);
+		++diagnostics.reloads;
+	}
+
+	saveConfig();
+	save();
 
-	menu_layer_reload_data(menu_layer);
+	scheduleWakeup();
+	refresh();
 }
 
-inline PairMap getPairs(void) {
+// Configs from before the single blob were spread over one key per string: pairs in 1..2n,
+// elements in the negative keys and the hours in 1000 and 2000.
+inline PairMap getLegacyPairs(void) {
 	PairMap pairs;
 	for(auto i = 1; persist_exists(2 * i - 1); ++i) {
 		int key_size = persist_get_size(2 * i - 1);
@@ -501,82 +1079,171 @@ inline PairMap getPairs(void) {
 		char* value = new char[value_size];
 		persist_read_string(2 * i - 1, key, key_size);
 		persist_read_string(2 * i, value, value_size);
-		pairs.insert(pair<char*, char*>(key, value));
+		pairs.insert(key, value);
 		delete[] key;
 		delete[] value;
 	}
 
 	if (pairs.empty()) {
-		pairs.insert(pair<char*, char*>("hardsimple", "work"));
-		pairs.insert(pair<char*, char*>("overviewoptimization", "additional"));
-		pairs.insert(pair<char*, char*>("workeducation", "main"));
-		pairs.insert(pair<char*, char*>("additionaldistractions", "secondary"));
+		pairs.insert("hardsimple", "work");
+		pairs.insert("overviewoptimization", "additional");
+		pairs.insert("workeducation", "main");
+		pairs.insert("additionaldistractions", "secondary");
 	}
 	return pairs;
 }
 
-inline vector<BaseTracking*> getElements(void) {
-	vector<BaseTracking*> elements;
-	for(auto i = -1; persist_exists(2 * i + 1); --i) {
+// Leaves past what the state can hold next to the pairs are left out, as a config with them would
+// be rejected.
+inline int countLegacyElements(PairMap const& pairs) {
+	int leaves = 0;
+	while (leaves < TrackingList::MAX_NODES - pairs.size() && persist_exists(-2 * leaves - 1))
+		++leaves;
+	return leaves > 0 ? leaves : DEFAULT_LEAVES;
+}
+
+inline void addLegacyElements(void) {
+	for(auto i = -1; i >= -TrackingList::MAX_LEAVES && persist_exists(2 * i + 1); --i) {
 		int title_size = persist_get_size(2 * i + 1);
 		char* title = new char[title_size];
 		persist_read_string(2 * i + 1, title, title_size);
 		int priority = persist_read_int(2 * i);
-		elements.push_back(new TrackingElement(title, priority));
+		trackingList->addElement(title, priority);
 		delete[] title;
 	}
-	if (elements.empty()) {
-		elements = vector<BaseTracking*> {
-			new TrackingElement("hard", 0),
-			new TrackingElement("simple", 0),
-			new TrackingElement("education", 1),
-			new TrackingElement("overview", 2),
-			new TrackingElement("optimization", 2),
-			new TrackingElement("distractions", 3)
-		};
+	if (trackingList->size() == 0) {
+		trackingList->addElement("hard", 0);
+		trackingList->addElement("simple", 0);
+		trackingList->addElement("education", 1);
+		trackingList->addElement("overview", 2);
+		trackingList->addElement("optimization", 2);
+		trackingList->addElement("distractions", 3);
 	}
-	return elements;
 }
 
-static void init(void) {
-	changeTimeAdds = { { 0, 60 * 60 }, { 1, 10 * 60 }, { 2, 1 * 60 } };
+inline void deleteLegacyConfig(void) {
+	for(auto i = 1; persist_exists(2 * i - 1); ++i) {
+		persist_delete(2 * i - 1);
+		persist_delete(2 * i);
+	}
+	for(auto i = -1; persist_exists(2 * i + 1); --i) {
+		persist_delete(2 * i + 1);
+		persist_delete(2 * i);
+	}
+	persist_delete(RECEIVED_HOURS_KEYMAP * 1);
+	persist_delete(RECEIVED_HOURS_KEYMAP * 2);
+}
 
-	PairMap pairs = getPairs();
-	vector<BaseTracking*> elements = getElements();
+inline void migrateConfig(void) {
+	PairMap pairs = getLegacyPairs();
+	int leaves = countLegacyElements(pairs);
 	if (persist_exists(RECEIVED_HOURS_KEYMAP)) {
 		int totalHours = persist_read_int(RECEIVED_HOURS_KEYMAP * 1);
 		int accTotalHours = persist_read_int(RECEIVED_HOURS_KEYMAP * 2);
-		trackingList = new TrackingList(elements, pairs, totalHours, accTotalHours);
+		trackingList = new TrackingList(leaves, pairs, totalHours, accTotalHours);
 	}
 	else {
-		trackingList = new TrackingList(elements, pairs);
+		trackingList = new TrackingList(leaves, pairs);
 	}
+	addLegacyElements();
+	saveConfig();
+	deleteLegacyConfig();
+}
+
+// Runs right after the first frame, which only needs the header snapshot. The config is a single
+// read parsed in place; the legacy keys are read once and replaced by it.
+static void loadModel(void*) {
+	++diagnostics.timers;
+	int size = persist_read_data(CONFIG_KEY, stateBuffer, sizeof(stateBuffer));
+	trackingList = size > 0 ? TrackingList::fromConfig(stateBuffer, size) : NULL;
+	if (!trackingList) {
+		if (size > 0)
+			app_log(APP_LOG_LEVEL_WARNING, __FILE__, __LINE__, "discarded saved config");
+		migrateConfig();
+	}
+	restore();
+	history = new History(HISTORY_KEY);
+	loggedActive = trackingList->getActiveNode();
+	window_set_click_config_provider(window, click_config_provider);
+	scheduleWakeup();
+	refresh();
+
+	app_message_register_inbox_received(handle_msg_received);
+	app_message_register_outbox_sent(handleOutboxSent);
+	app_message_register_outbox_failed(handleOutboxFailed);
+	outboxSize = min(app_message_outbox_size_maximum(), (uint32_t)HistoryExport::OUTBOX_SIZE);
+	app_message_open(ConfigReceiver::INBOX_SIZE, outboxSize);
+
+	bluetoothLastState = bluetooth_connection_service_peek();
+	bluetooth_connection_service_subscribe(handleBluetooth);
+	tick_timer_service_subscribe(MINUTE_UNIT, handleTick);
+}
+
+static void init(void) {
+	diagnostics = Diagnostics();
+	alarms.clear();
+	if (persist_read_data(HEADER_KEY, &header, sizeof(header)) != sizeof(header))
+		memset(&header, 0, sizeof(header));
+	headerStale = false;
 
 	status_font = fonts_get_system_font(FONT_KEY_GOTHIC_14_BOLD);
 	window = window_create();
-	window_set_click_config_provider(window, click_config_provider);
 
 	static WindowHandlers windowHandlers;
 	windowHandlers.load = window_load;
 	windowHandlers.unload = window_unload;
 	window_set_window_handlers(window, windowHandlers);
 
-	deserialize();
-	window_stack_push(window, true);
+	historyWindow = window_create();
+	window_set_click_config_provider(historyWindow, history_click_config_provider);
+	static WindowHandlers historyWindowHandlers;
+	historyWindowHandlers.load = history_window_load;
+	historyWindowHandlers.unload = history_window_unload;
+	window_set_window_handlers(historyWindow, historyWindowHandlers);
 
-	app_message_register_inbox_received(handle_msg_received);
-	app_message_open(app_message_inbox_size_maximum(), APP_MESSAGE_OUTBOX_SIZE_MINIMUM);
+	diagnosticsWindow = window_create();
+	window_set_click_config_provider(diagnosticsWindow, diagnostics_click_config_provider);
+	static WindowHandlers diagnosticsWindowHandlers;
+	diagnosticsWindowHandlers.load = diagnostics_window_load;
+	diagnosticsWindowHandlers.unload = diagnostics_window_unload;
+	window_set_window_handlers(diagnosticsWindow, diagnosticsWindowHandlers);
 
-	bluetoothLastState = bluetooth_connection_service_peek();
-	bluetooth_connection_service_subscribe(handleBluetooth);
-	tick_timer_service_subscribe(SECOND_UNIT, handleTick);
+	window_stack_push(window, true);
+	app_timer_register(0, loadModel, NULL);
 }
 
 static void deinit(void) {
 	tick_timer_service_unsubscribe();
-	serialize();
+	if (wakeupTimer)
+		app_timer_cancel(wakeupTimer);
+	if (saveTimer)
+		app_timer_cancel(saveTimer);
+	wakeupTimer = saveTimer = NULL;
+	historyDue = 0;
+	if (history)
+		history->flush();
+	delete history;
+	history = NULL;
+	stopExport();
+	delete rollup;
+	rollup = NULL;
+	if (trackingList && trackingList->getRevision() != savedRevision)
+		save();
+	if (trackingList && headerStale)
+		saveHeader();
+	window_destroy(diagnosticsWindow);
+	window_destroy(historyWindow);
 	window_destroy(window);
+	delete trackingList;
+	trackingList = NULL;
+}
+
+#ifdef TRACKER_HOST
+// Lets the host simulator check the model between events.
+TrackingList const* getTrackingList() {
+	return trackingList;
 }
+#endif
 
 int main(void) {
 	init();
@@ -1,127 +1,508 @@
 #include "tracker_data.hpp"
-#include <numeric>
+#include "journal.hpp"
 
-const int TrackingList::HEADER_SIZE = 11;
+const int TrackingList::HEADER_SIZE = 13;
+const int TrackingList::RECORD_SIZE = 5;
+const int TrackingList::CHECKSUM_SIZE = 2;
+const schar TrackingList::BINARY_VERSION = 1;
+const int TrackingList::LEGACY_HEADER_SIZE = 11;
+const int TrackingList::MAX_NODES = (Journal::MAX_IMAGE_SIZE - HEADER_SIZE - CHECKSUM_SIZE) / RECORD_SIZE;
+const int TrackingList::CONFIG_HEADER_SIZE = 6;
+const int TrackingList::GOAL_SIZE = 4;
+const schar TrackingList::CONFIG_VERSION = 2;
 
-using namespace std;
+static uint16_t checksum(schar const*, int);
 
-char const* BaseTracking::getName() const {
-	return name;
+void PairMap::insert(char const* key, char const* name) {
+	NameId keyId = names.intern(key);
+	NameId nameId = names.intern(name);
+	if (keyId == NULL_NAME || nameId == NULL_NAME || !pairs.insert(keyId, nameId))
+		app_log(APP_LOG_LEVEL_WARNING, __FILE__, __LINE__, "pair %s dropped", name);
 }
 
-int BaseTracking::getTime() const {
-	return time;
+TrackingList::TrackingList(int leaves, PairMap& pairs) {
+	this->possiblePairs = pairs;
+	leafCapacity = leaves;
+	nodeCapacity = max(2 * leaves - 1, 0);
+	nodes = new TrackingNode[nodeCapacity]();
+	rows = new NodeIndex[leaves];
 }
 
-TrackingElement::TrackingElement(char* name, int priority) {
-	this->name = new char[strlen(name) + 1];
-	strcpy(this->name, name);
-	this->priority = priority;
+TrackingList::TrackingList(int leaves, PairMap& pairs, int totalHours, int totalAccHours) : TrackingList(leaves, pairs) {
+	this->totalHours = totalHours;
+	this->totalAccHours = totalAccHours;
 }
 
-TrackingElement::~TrackingElement() {
-	delete[] name;
+TrackingList::~TrackingList() {
+	delete[] nodes;
+	delete[] rows;
+}
+
+void TrackingList::addElement(char const* name, int priority) {
+	NameId nameId;
+	if (leafCount == leafCapacity || (nameId = possiblePairs.names.intern(name)) == NULL_NAME)
+		return;
+	TrackingNode& element = nodes[leafCount];
+	element.name = nameId;
+	element.priority = priority;
+	element.height = 1;
+	element.parent = element.element1 = element.element2 = NULL_V;
+	rows[rowCount++] = leafCount++;
+	nodeHighWater = max(nodeHighWater, ++usedNodes);
+}
+
+// Adds the next pair of an already compiled tree; elements are node slots of earlier leaves or pairs.
+void TrackingList::addPair(NodeIndex element1, NodeIndex element2, char const* name) {
+	NameId nameId;
+	int index = leafCapacity + pairCount;
+	if (index >= nodeCapacity || (nameId = possiblePairs.names.intern(name)) == NULL_NAME)
+		return;
+	pairsCompiled = true;
+	++pairCount;
+	TrackingNode& pair = nodes[index];
+	pair.name = nameId;
+	pair.parent = pair.element1 = pair.element2 = NULL_V;
+	NodeIndex elements[] = { element1, element2 };
+	for(NodeIndex element : elements) {
+		if (element < 0 || element >= index || (element >= leafCount && element < leafCapacity) || nodes[element].parent != NULL_V)
+			return;
+	}
+	if (element1 == element2)
+		return;
+	pair.element1 = element1;
+	pair.element2 = element2;
+	nodes[element1].parent = nodes[element2].parent = index;
+}
+
+// Goals of nodes the config does not have are dropped, as are those past the capacity.
+void TrackingList::addGoal(NodeIndex node, int minutes, int pattern) {
+	if (node < 0 || node >= nodeCapacity || !*getNodeName(node) || minutes <= 0 || goals.full())
+		return;
+	Goal goal = { node, (schar)pattern, (uint16_t)minutes };
+	goals.push_back(goal);
+}
+
+// Empty for the leaf slots past the last leaf and for pairs the config does not have.
+char const* TrackingList::getNodeName(NodeIndex node) const {
+	if ((node >= leafCount && node < leafCapacity) || node >= leafCapacity + pairCount)
+		return "";
+	return possiblePairs.names.get(nodes[node].name);
+}
+
+// Layout: version, leaf count, pair count, total hours, total accumulated hours (2 bytes), then the
+// priority and name of every leaf, the two element slots and name of every pair, since version 2
+// the goal count and the node, pattern and minutes (2 bytes) of every goal, and a checksum.
+// Names are interned straight from the buffer, so the whole config is one read and one pass.
+TrackingList* TrackingList::fromConfig(schar const* s, int length) {
+	if (length < CONFIG_HEADER_SIZE + CHECKSUM_SIZE || s[0] < 1 || s[0] > CONFIG_VERSION ||
+			*(uint16_t*)(s + length - CHECKSUM_SIZE) != checksum(s, length - CHECKSUM_SIZE))
+		return NULL;
+	// Past MAX_LEAVES the node slots overflow a NodeIndex, past MAX_NODES the state could not be
+	// saved, and a tree has fewer pairs than leaves.
+	int leaves = (uint8_t)s[1];
+	int pairs = (uint8_t)s[2];
+	if (leaves > MAX_LEAVES || leaves + pairs > MAX_NODES || pairs >= leaves)
+		return NULL;
+	PairMap none;
+	TrackingList* list = new TrackingList(leaves, none, (uint8_t)s[3], *(uint16_t*)(s + 4));
+	char const* p = (char const*)s + CONFIG_HEADER_SIZE;
+	char const* end = (char const*)s + length - CHECKSUM_SIZE;
+	for(int i = 0; i < leaves + pairs; ++i) {
+		int fields = i < leaves ? 1 : 2;
+		char const* name = p + fields;
+		if (name >= end || memchr(name, '\0', end - name) == NULL)
+			break;
+		if (i < leaves)
+			list->addElement(name, p[0]);
+		else
+			list->addPair(p[0], p[1], name);
+		p = name + strlen(name) + 1;
+	}
+	if (s[0] >= 2 && p < end) {
+		int goals = (uint8_t)*p++;
+		for(int i = 0; i < goals && p + GOAL_SIZE <= end; ++i, p += GOAL_SIZE)
+			list->addGoal(p[0], *(uint16_t*)(p + 2), p[1]);
+	}
+	if (p != end || list->leafCount != leaves || list->pairCount != pairs) {
+		delete list;
+		return NULL;
+	}
+	return list;
+}
+
+int TrackingList::serializeConfig(schar* s, int length) {
+	if (!pairsCompiled)
+		compilePairs();
+	StringPool const& names = possiblePairs.names;
+	int offset = CONFIG_HEADER_SIZE;
+	for(int i = 0; i < leafCapacity + pairCount; ++i) {
+		if (i >= leafCount && i < leafCapacity)
+			continue;
+		int fields = i < leafCapacity ? 1 : 2;
+		char const* name = names.get(nodes[i].name);
+		int size = strlen(name) + 1;
+		if (offset + fields + size + CHECKSUM_SIZE > length)
+			return 0;
+		if (i < leafCapacity) {
+			s[offset] = nodes[i].priority;
+		}
+		else {
+			s[offset] = nodes[i].element1;
+			s[offset + 1] = nodes[i].element2;
+		}
+		memcpy(s + offset + fields, name, size);
+		offset += fields + size;
+	}
+	if (offset + 1 + GOAL_SIZE * goals.size() + CHECKSUM_SIZE > length)
+		return 0;
+	s[offset++] = (schar)goals.size();
+	for(Goal const& goal : goals) {
+		s[offset] = goal.node;
+		s[offset + 1] = goal.pattern;
+		*(uint16_t*)(s + offset + 2) = goal.minutes;
+		offset += GOAL_SIZE;
+	}
+	s[0] = CONFIG_VERSION;
+	s[1] = (schar)leafCount;
+	s[2] = (schar)pairCount;
+	s[3] = (schar)totalHours;
+	*(uint16_t*)(s + 4) = totalAccHours;
+	*(uint16_t*)(s + offset) = checksum(s, offset);
+	return offset + CHECKSUM_SIZE;
+}
+
+// Resolves the joined-name keys of the config once, on the first merge. Each pair takes the slot
+// after the leaves in config order and becomes the parent of both of its elements, so a merge
+// afterwards is a parent check instead of a name lookup.
+void TrackingList::compilePairs() {
+	pairsCompiled = true;
+	StringPool const& names = possiblePairs.names;
+	pairCount = min(possiblePairs.pairs.size(), nodeCapacity - leafCapacity);
+	int namedNodes = leafCapacity + pairCount;
+	NodeIndex* byName = new NodeIndex[names.size()];
+	memset(byName, NULL_V, names.size() * sizeof(NodeIndex));
+	for(int i = 0; i < namedNodes; ++i) {
+		if (i >= leafCount && i < leafCapacity)
+			continue;
+		if (i >= leafCapacity) {
+			nodes[i].name = possiblePairs.pairs[i - leafCapacity].value;
+			nodes[i].parent = nodes[i].element1 = nodes[i].element2 = NULL_V;
+		}
+		if (byName[nodes[i].name] == NULL_V)
+			byName[nodes[i].name] = i;
+	}
+
+	for(int k = 0; k < pairCount; ++k) {
+		char const* key = names.get(possiblePairs.pairs[k].key);
+		for(int a = 0; a < namedNodes; ++a) {
+			if (a >= leafCount && a < leafCapacity)
+				continue;
+			size_t length = strlen(names.get(nodes[a].name));
+			NameId rest;
+			if (strncmp(key, names.get(nodes[a].name), length) != 0 || (rest = names.find(key + length)) == NULL_NAME)
+				continue;
+			NodeIndex b = byName[rest];
+			if (b != NULL_V && b != a && nodes[a].parent == NULL_V && nodes[b].parent == NULL_V) {
+				TrackingNode& pair = nodes[leafCapacity + k];
+				pair.element1 = a;
+				pair.element2 = b;
+				nodes[a].parent = nodes[b].parent = leafCapacity + k;
+				break;
+			}
+		}
+	}
+	delete[] byName;
+}
+
+// Takes over the times, totals and active slot of the list a new config replaces. Leaves are
+// matched by name and a new one starts at zero; rows that were merged are merged again wherever the
+// new config has a pair of the same name. Returns whether every node kept its slot, name and
+// elements, so that whatever is keyed by node slot stays valid.
+bool TrackingList::carryOver(TrackingList& old) {
+	if (!pairsCompiled)
+		compilePairs();
+	if (!old.pairsCompiled)
+		old.compilePairs();
+	bool sameNodes = leafCapacity == old.leafCapacity && leafCount == old.leafCount && pairCount == old.pairCount;
+	for(int i = 0; sameNodes && i < leafCapacity + pairCount; ++i) {
+		sameNodes = strcmp(getNodeName(i), old.getNodeName(i)) == 0 &&
+			nodes[i].element1 == old.nodes[i].element1 && nodes[i].element2 == old.nodes[i].element2;
+	}
+
+	old.updateTime();
+	NodeIndex* oldRows = new NodeIndex[old.rowCount];
+	memcpy(oldRows, old.rows, old.rowCount * sizeof(NodeIndex));
+	int oldRowCount = old.rowCount;
+	NodeIndex oldActive = old.activeIndex1 != NULL_V ? old.rows[old.activeIndex1] : NULL_V;
+	NodeIndex oldSelected = old.selectedIndex != NULL_V ? old.rows[old.selectedIndex] : NULL_V;
+	old.breakAll();
+
+	bool* taken = new bool[old.leafCount]();
+	runningTime = 0;
+	for(int i = 0; i < leafCount; ++i) {
+		for(int j = 0; j < old.leafCount; ++j) {
+			if (!taken[j] && strcmp(getNodeName(i), old.getNodeName(j)) == 0) {
+				taken[j] = true;
+				nodes[i].time = old.nodes[j].time;
+				runningTime += nodes[i].time;
+				break;
+			}
+		}
+	}
+	delete[] taken;
+
+	for(int k = 0; k < oldRowCount; ++k) {
+		NodeIndex pair = oldRows[k] >= old.leafCapacity ? findNode(old.getNodeName(oldRows[k])) : NULL_V;
+		if (pair < leafCapacity)
+			continue;
+		for(bool merged = true; merged;) {
+			merged = false;
+			for(int i = 0; i + 1 < size(); ++i) {
+				if (rows[i] != pair && contains(pair, rows[i]) && buildPair(i, i + 1))
+					merged = true;
+			}
+		}
+	}
+	delete[] oldRows;
+
+	mode = old.mode;
+	activeIndex1 = oldActive != NULL_V ? findRow(old.getNodeName(oldActive)) : NULL_V;
+	activeIndex2 = NULL_V;
+	selectedIndex = oldSelected != NULL_V ? findRow(old.getNodeName(oldSelected)) : NULL_V;
+	lastTimeStamp = old.lastTimeStamp;
+	accumulatedTime = old.accumulatedTime;
+	++revision;
+	changedLayout = changedHeader = true;
+	clearSteps();
+	checkTotals();
+	return sameNodes;
+}
+
+NodeIndex TrackingList::findNode(char const* name) const {
+	for(int i = 0; i < leafCapacity + pairCount; ++i) {
+		if ((i < leafCount || i >= leafCapacity) && strcmp(getNodeName(i), name) == 0)
+			return i;
+	}
+	return NULL_V;
 }
 
-int TrackingElement::getPriority() const {
-	return priority;
+int TrackingList::findRow(char const* name) const {
+	for(int i = 0; i < size(); ++i) {
+		if (strcmp(getName(i), name) == 0)
+			return i;
+	}
+	return NULL_V;
 }
 
-int TrackingElement::getHeight() const {
-	return 1;
+// The time of a node's row, or the sum of the rows it is split into. NULL_V while it is merged
+// into a larger row, which does not know the share of it.
+int TrackingList::getNodeTime(NodeIndex node) const {
+	int time = NULL_V;
+	for(int i = 0; i < size(); ++i) {
+		if (contains(node, rows[i]))
+			time = max(time, 0) + at(i)->time;
+		else if (contains(rows[i], node))
+			return NULL_V;
+	}
+	return time;
 }
 
-TrackingPair::TrackingPair(char* name, BaseTracking* element1, BaseTracking* element2) {
-	this->name = name;
-	this->element1 = element1;
-	this->element2 = element2;
-	this->time = element1->getTime() + element2->getTime();
+bool TrackingList::accruesTo(NodeIndex node) const {
+	NodeIndex active = getActiveNode();
+	return active != NULL_V && contains(node, active);
 }
 
-int TrackingPair::getPriority() const {
-	return min(element1->getPriority(), element2->getPriority());
+// The row of the node itself, of the pair it is merged into or, for a split pair, of its first leaf.
+int TrackingList::findRow(NodeIndex node) const {
+	for(int i = 0; node != NULL_V && i < size(); ++i) {
+		if (contains(rows[i], node) || contains(node, rows[i]))
+			return i;
+	}
+	return NULL_V;
 }
 
-int TrackingPair::getHeight() const {
-	return element1->getHeight() + element2->getHeight();
+bool TrackingList::contains(NodeIndex ancestor, NodeIndex node) const {
+	for(; node != NULL_V; node = nodes[node].parent) {
+		if (node == ancestor)
+			return true;
+	}
+	return false;
 }
 
-TrackingList::TrackingList(std::vector<BaseTracking*> elements, PairMap& pairs) : vector<BaseTracking*>(elements) {
-	this->possiblePairs = pairs;
+void TrackingList::insertRow(int index, NodeIndex node) {
+	memmove(rows + index + 1, rows + index, (rowCount - index) * sizeof(NodeIndex));
+	rows[index] = node;
+	++rowCount;
 }
 
-TrackingList::TrackingList(std::vector<BaseTracking*> elements, PairMap& pairs, int totalHours, int totalAccHours) : TrackingList(elements, pairs) {
-	this->totalHours = totalHours;
-	this->totalAccHours = totalAccHours;
+void TrackingList::eraseRow(int index) {
+	memmove(rows + index, rows + index + 1, (rowCount - index - 1) * sizeof(NodeIndex));
+	--rowCount;
 }
 
-TrackingList::~TrackingList() {
-	for(int i = 0; i < size(); ++i) {
-		while(at(i)->getHeight() > 1)
-			breakPair(i);
-	}
-	for_each(this->begin(), this->end(), [](BaseTracking* e) {delete e;});
-	for_each(possiblePairs.begin(), possiblePairs.end(), [](std::pair<char*, char*> e) {
-		delete[] e.first;
-		delete[] e.second;
-	});
+// Layout: version, mode, selected and active index, last time stamp, accumulated time, record
+// count, then one record per visible tree node in post-order (time followed by ',' for a leaf or
+// ')' for the pair closing its last two subtrees) and a Fletcher-16 checksum over all of it.
+int TrackingList::getBinarySize() const {
+	return HEADER_SIZE + RECORD_SIZE * usedNodes + CHECKSUM_SIZE;
 }
 
-int TrackingList::getBinarySize() {
-	return HEADER_SIZE + 5 * totalHeight();
+static uint16_t checksum(schar const* s, int size) {
+	uint16_t sum1 = 0, sum2 = 0;
+	for(int i = 0; i < size; ++i) {
+		sum1 = (sum1 + (uint8_t)s[i]) % 255;
+		sum2 = (sum2 + sum1) % 255;
+	}
+	return sum2 << 8 | sum1;
 }
 
-schar* TrackingList::serialize() {
-	schar* s = new schar[getBinarySize()]();
-	s[0] = (schar)mode;
-	s[1] = (schar)selectedIndex;
-	s[2] = (schar)activeIndex1;
-	*(int*)(s + 3) = lastTimeStamp;
-	*(int*)(s + 7) = accumulatedTime;
-	for(int i = 0; i < size(); ++i) {
-		while(at(i)->getHeight() > 1) {
-			s[HEADER_SIZE + (i + at(i)->getHeight()) * 5 - 1] = ')';
-			breakPair(i);
+int TrackingList::writeNode(schar* s, NodeIndex index) const {
+	TrackingNode const& node = nodes[index];
+	if (node.height > 1) {
+		s = s + writeNode(s, node.element1);
+		s = s + writeNode(s, node.element2);
+	}
+	*(int*)s = node.time;
+	s[RECORD_SIZE - 1] = node.height > 1 ? ')' : ',';
+	return RECORD_SIZE * (2 * node.height - 1);
+}
+
+int TrackingList::serialize(schar* s, int length) const {
+	int binarySize = getBinarySize();
+	if (length < binarySize)
+		return 0;
+	s[0] = BINARY_VERSION;
+	s[1] = (schar)mode;
+	s[2] = (schar)selectedIndex;
+	s[3] = (schar)activeIndex1;
+	*(int*)(s + 4) = lastTimeStamp;
+	*(int*)(s + 8) = accumulatedTime;
+	s[12] = (schar)usedNodes;
+	int offset = HEADER_SIZE;
+	for(int i = 0; i < size(); ++i)
+		offset += writeNode(s + offset, rows[i]);
+	*(uint16_t*)(s + offset) = checksum(s, offset);
+	return binarySize;
+}
+
+bool TrackingList::deserialize(schar const* s, int length) {
+	int records = length > HEADER_SIZE ? (uint8_t)s[12] : 0;
+	if (length != HEADER_SIZE + RECORD_SIZE * records + CHECKSUM_SIZE || s[0] != BINARY_VERSION ||
+			*(uint16_t*)(s + length - CHECKSUM_SIZE) != checksum(s, length - CHECKSUM_SIZE) ||
+			(uint8_t)s[1] > FREEZE_MODE)
+		return false;
+
+	breakAll();
+	int k = 0;
+	for(int i = 0; i < records; ++i) {
+		schar const* record = s + HEADER_SIZE + i * RECORD_SIZE;
+		if (record[RECORD_SIZE - 1] == ',' && k < size()) {
+			++k;
 		}
-		*(int*)(s + HEADER_SIZE + i * 5) = at(i)->time;
-		if (s[HEADER_SIZE + i * 5 + 4] != ')')
-			s[HEADER_SIZE + i * 5 + 4] = ',';
+		else if (record[RECORD_SIZE - 1] == ')' && k >= 2 && buildPair(k - 2, k - 1)) {
+			--k;
+		}
+		else {
+			clear();
+			return false;
+		}
+		runningTime += shiftTime(row(k - 1), *(int*)record - row(k - 1).time);
 	}
-	app_log(APP_LOG_LEVEL_DEBUG, __FILE__, __LINE__, "%02x%02x%02x", s[0], s[1], s[2]);
-	app_log(APP_LOG_LEVEL_DEBUG, __FILE__, __LINE__, "%d", *(int*)(s + 3));
-	app_log(APP_LOG_LEVEL_DEBUG, __FILE__, __LINE__, "%d", *(int*)(s + 7));
-	for(int i = 0; i < size(); ++i) {
-		app_log(APP_LOG_LEVEL_DEBUG, __FILE__, __LINE__, "%d%c", *(int*)(s + HEADER_SIZE + i * 5), s[HEADER_SIZE + i * 5 + 4]);
+	if (k != size()) {
+		clear();
+		return false;
 	}
-	return s;
+
+	mode = (TrackingListMode)s[1];
+	selectedIndex = s[2] >= 0 && s[2] < k ? s[2] : NULL_V;
+	activeIndex1 = s[3] >= 0 && s[3] < k ? s[3] : NULL_V;
+	activeIndex2 = NULL_V;
+	lastTimeStamp = *(int*)(s + 4);
+	accumulatedTime = *(int*)(s + 8);
+	++revision;
+	changedLayout = true;
+	clearSteps();
+	updateTime();
+	return true;
 }
 
-void TrackingList::deserialize(schar* s) {
-	for(int i = 0, k = 0; k < size(); ++i) {
-		at(k)->time = *(int*)(s + HEADER_SIZE + i * 5);
-		if (s[HEADER_SIZE + i * 5 + 4] == ',')
+// The state the first versions kept in key 0: mode, selected and active index, last time stamp and
+// accumulated time, then the time of every leaf followed by ',' or by ')' when it closes a pair
+// with the row before it. There is no version or checksum, so only the size is checked against
+// the leaves; a pair the config no longer has stays split.
+bool TrackingList::deserializeLegacy(schar const* s, int length) {
+	int records = (length - LEGACY_HEADER_SIZE) / RECORD_SIZE;
+	if (length < LEGACY_HEADER_SIZE || records * RECORD_SIZE != length - LEGACY_HEADER_SIZE || records != leafCount ||
+			(uint8_t)s[0] > FREEZE_MODE)
+		return false;
+	breakAll();
+
+	int k = 0;
+	for(int i = 0; i < records; ++i) {
+		schar const* record = s + LEGACY_HEADER_SIZE + i * RECORD_SIZE;
+		runningTime += shiftTime(row(k), *(int*)record - row(k).time);
+		if (record[RECORD_SIZE - 1] != ')' || k == 0 || !buildPair(k - 1, k))
 			++k;
-		else
-			buildPair(k - 1, k);
 	}
+
 	mode = (TrackingListMode)s[0];
-	selectedIndex = s[1];
-	activeIndex1 = s[2];
+	selectedIndex = s[1] >= 0 && s[1] < k ? s[1] : NULL_V;
+	activeIndex1 = s[2] >= 0 && s[2] < k ? s[2] : NULL_V;
+	activeIndex2 = NULL_V;
 	lastTimeStamp = *(int*)(s + 3);
 	accumulatedTime = *(int*)(s + 7);
+	++revision;
+	changedLayout = true;
+	clearSteps();
 	updateTime();
+	return true;
+}
+
+void TrackingList::clear() {
+	breakAll();
+	for(int i = 0; i < size(); ++i)
+		row(i).time = 0;
+	runningTime = 0;
+	activeIndex1 = NULL_V;
+	++revision;
+	changedLayout = true;
+	clearSteps();
+}
+
+int TrackingList::shiftTime(TrackingNode& element, int value) {
+	int oldTime = element.time;
+	element.time = max(0, oldTime + value);
+	return element.time - oldTime;
 }
 
 void TrackingList::addTime(int value) {
 	if (selectedIndex != NULL_V) {
-		this->at(selectedIndex)->time = max(0, this->at(selectedIndex)->time + value);
-		if (activeIndex1 != NULL_V && activeIndex1 != selectedIndex) {
-			this->at(activeIndex1)->time = max(0, this->at(activeIndex1)->time - value);
-		}
+		editRow(selectedIndex, value);
+		if (activeIndex1 != NULL_V && activeIndex1 != selectedIndex)
+			editRow(activeIndex1, -value);
 	}
 	else {
-		accumulatedTime = max(0, accumulatedTime + value);
+		editAccumulated(value);
 	}
+	++revision;
+	checkTotals();
+}
+
+// Moves the time of a row, logging by how much it actually moved for the history and for undo.
+void TrackingList::editRow(int index, int value) {
+	int shifted = shiftTime(row(index), value);
+	runningTime += shifted;
+	markRow(index);
+	addEvent(HISTORY_EDIT, rows[index], shifted);
+	record(CHANGE_EDIT, rows[index], shifted);
+}
+
+void TrackingList::editAccumulated(int value) {
+	int oldTime = accumulatedTime;
+	accumulatedTime = max(0, accumulatedTime + value);
+	changedHeader = true;
+	addEvent(HISTORY_EDIT, NULL_V, accumulatedTime - oldTime);
+	record(CHANGE_EDIT, NULL_V, accumulatedTime - oldTime);
 }
 
 void TrackingList::subTime(int value) {
@@ -131,6 +512,8 @@ void TrackingList::subTime(int value) {
 void TrackingList::switchMode(TrackingListMode newMode) {
 	updateTime();
 	this->mode = newMode;
+	++revision;
+	changedHeader = true;
 }
 
 void TrackingList::resetIndex() {
@@ -147,6 +530,7 @@ void TrackingList::restorePreviousActive() {
 	activeIndex1 = activeIndex2;
 	activeIndex2 = selectedIndex;
 	selectedIndex = activeIndex1;
+	++revision;
 }
 
 void TrackingList::incIndex() {
@@ -199,6 +583,7 @@ void TrackingList::switchIndex() {
 				}
 				break;
 		}
+		++revision;
 	}
 }
 
@@ -224,29 +609,39 @@ bool TrackingList::buildPair(int activeIndex2) {
 
 bool TrackingList::buildPair(int activeIndex1, int activeIndex2) {
 	if (activeIndex2 < activeIndex1)
-		std::swap(activeIndex1, activeIndex2);
-	char pairNameKey[25];
-	strcpy(pairNameKey, this->at(activeIndex1)->name);
-	strcat(pairNameKey, this->at(activeIndex2)->name);
+		swap(activeIndex1, activeIndex2);
+	if (!pairsCompiled)
+		compilePairs();
 
 	bool result = false;
-	if (possiblePairs.find(pairNameKey) != possiblePairs.end()) {
-		char* pairName = possiblePairs[pairNameKey];
-		BaseTracking* newPair = new TrackingPair(pairName, this->at(activeIndex1), this->at(activeIndex2));
-		erase(this->begin() + activeIndex1, this->begin() + activeIndex2 + 1);
-		insert(this->begin() + activeIndex1, newPair);
+	NodeIndex pairIndex = row(activeIndex1).parent;
+	if (pairIndex != NULL_V && nodes[pairIndex].element1 == rows[activeIndex1] && nodes[pairIndex].element2 == rows[activeIndex2]) {
+		TrackingNode& pair = nodes[pairIndex];
+		TrackingNode& element1 = row(activeIndex1);
+		TrackingNode& element2 = row(activeIndex2);
+		pair.time = element1.time + element2.time;
+		pair.priority = min(element1.priority, element2.priority);
+		pair.height = element1.height + element2.height;
+		rows[activeIndex1] = pairIndex;
+		eraseRow(activeIndex2);
+		record(CHANGE_MERGE, pairIndex, 0);
+		nodeHighWater = max(nodeHighWater, ++usedNodes);
 		this->activeIndex1 = activeIndex1;
+		++revision;
+		changedLayout = true;
 		result = true;
 	}
 
+	checkTotals();
 	return result;
 }
 
 bool TrackingList::buildAll() {
 	for(int i = 0; i < size() - 1; ++i) {
-		while(buildPair(i, i + 1));
+		while(i < size() - 1 && buildPair(i, i + 1));
 	}
 	activeIndex1 = NULL_V;
+	++revision;
 	return true;
 }
 
@@ -262,18 +657,15 @@ bool TrackingList::breakPair() {
 	return true;
 }
 
-bool TrackingList::breakPair(int index) {
-	if (this->at(index)->getHeight() == 1)
-		return false;
-	TrackingPair* pair = static_cast<TrackingPair*>(this->at(index));
-
-	BaseTracking* element1 = pair->element1;
-	BaseTracking* element2 = pair->element2;
-	int timeDiff = pair->time - element1->time - element2->time;
-	if (element1->getPriority() == element2->getPriority()) {
+// A pair's time beyond the sum of its elements goes to the higher priority one. Between equal
+// priorities it first closes the gap between them and the rest is shared evenly. No element is
+// left with a negative time.
+void TrackingList::shareTime(TrackingNode const& pair, TrackingNode* element1, TrackingNode* element2) {
+	int timeDiff = pair.time - element1->time - element2->time;
+	if (element1->priority == element2->priority) {
 		if (element1->time != element2->time) {
-			BaseTracking* outRunning;
-			BaseTracking* lagging;
+			TrackingNode* outRunning;
+			TrackingNode* lagging;
 			if (element1->time < element2->time == timeDiff > 0) {
 				lagging = element1;
 				outRunning = element2;
@@ -295,7 +687,7 @@ bool TrackingList::breakPair(int index) {
 		element1->time += timeDiff / 2 + timeDiff % 2;
 		element2->time += timeDiff / 2;
 	}
-	else if (timeDiff > 0 == element1->getPriority() < element2->getPriority()) {
+	else if (timeDiff > 0 == element1->priority < element2->priority) {
 		element1->time += timeDiff;
 		if (element1->time < 0) {
 			element2->time += element1->time;
@@ -309,21 +701,81 @@ bool TrackingList::breakPair(int index) {
 			element2->time = 0;
 		}
 	}
+}
+
+bool TrackingList::breakPair(int index) {
+	if (row(index).height == 1)
+		return false;
+	TrackingNode& pair = row(index);
+	record(CHANGE_SPLIT, rows[index], nodes[pair.element1].time, nodes[pair.element2].time);
+	shareTime(pair, nodes + pair.element1, nodes + pair.element2);
 
-	erase(this->begin() + index);
-	delete pair;
-	insert(this->begin() + index, element2);
-	insert(this->begin() + index, element1);
+	rows[index] = pair.element1;
+	insertRow(index + 1, pair.element2);
+	--usedNodes;
+	++revision;
+	changedLayout = true;
 
+	checkTotals();
 	return true;
 }
 
-bool TrackingList::breakAll() {
-	for(int i = 0; i < size(); ++i) {
-		while(at(i)->getHeight() > 1) {
-			breakPair(i);
+// Writes the leaves under a node to leaves in order. A pair shares its time out before its
+// elements are split in turn, which is all breakPair level by level does, so the leaves end up
+// with the same times. The stack holds at most one pending element per level.
+int TrackingList::splitNode(NodeIndex top, NodeIndex* leaves) {
+	NodeIndex pending[MAX_LEAVES];
+	int pendingCount = 0;
+	int leafCount = 0;
+	pending[pendingCount++] = top;
+	while (pendingCount > 0) {
+		NodeIndex index = pending[--pendingCount];
+		TrackingNode const& node = nodes[index];
+		if (node.height == 1) {
+			leaves[leafCount++] = index;
+			continue;
 		}
+		record(CHANGE_SPLIT, index, nodes[node.element1].time, nodes[node.element2].time);
+		shareTime(node, nodes + node.element1, nodes + node.element2);
+		pending[pendingCount++] = node.element2;
+		pending[pendingCount++] = node.element1;
+		--usedNodes;
+	}
+	return leafCount;
+}
+
+bool TrackingList::breakTree(int index) {
+	int height = row(index).height;
+	if (height == 1)
+		return false;
+	NodeIndex top = rows[index];
+	memmove(rows + index + height, rows + index + 1, (rowCount - index - 1) * sizeof(NodeIndex));
+	rowCount += height - 1;
+	splitNode(top, rows + index);
+	++revision;
+	changedLayout = true;
+
+	checkTotals();
+	return true;
+}
+
+// Rows are split from the last one back, each writing its leaves just before those of the rows
+// after it. A row always ends at or after its own index, so no row is overwritten before it is
+// read and the whole list takes one pass.
+bool TrackingList::breakAll() {
+	if (rowCount == leafCount)
+		return true;
+	int end = leafCount;
+	for(int i = rowCount - 1; i >= 0; --i) {
+		NodeIndex top = rows[i];
+		end -= nodes[top].height;
+		splitNode(top, rows + end);
 	}
+	rowCount = leafCount;
+	++revision;
+	changedLayout = true;
+
+	checkTotals();
 	return true;
 }
 
@@ -331,30 +783,174 @@ int TrackingList::updateTime() {
 	time_t currentTime = time(0L);
 	int newTime = NULL_V;
 	if (mode == NORMAL_MODE && lastTimeStamp != NULL_V && activeIndex1 != NULL_V) {
-		this->at(activeIndex1)->time += currentTime - lastTimeStamp;
-		newTime = this->at(activeIndex1)->time;
+		row(activeIndex1).time += currentTime - lastTimeStamp;
+		runningTime += currentTime - lastTimeStamp;
+		newTime = row(activeIndex1).time;
+		if (currentTime != lastTimeStamp)
+			markRow(activeIndex1);
 	}
 	lastTimeStamp = currentTime;
+	checkTotals();
 	return newTime;
 }
 
 void TrackingList::resetSelectedTime() {
 	if (selectedIndex != NULL_V)
-		this->at(selectedIndex)->time = 0;
+		editRow(selectedIndex, -row(selectedIndex).time);
 	else
-		accumulatedTime = 0;
+		editAccumulated(-accumulatedTime);
+	++revision;
+	checkTotals();
 }
 
+// Undone like edits of every row and the accumulated total.
 void TrackingList::resetTime(bool resetAccumulated) {
+	addEvent(HISTORY_RESET, NULL_V, resetAccumulated);
+	record(CHANGE_EDIT, NULL_V, resetAccumulated ? -accumulatedTime : runningTime);
 	if (resetAccumulated)
 		accumulatedTime = 0;
 	else
-		accumulatedTime += totalTime(false);
-	for_each(this->begin(), this->end(), [](BaseTracking* a) { a->time = 0; });
+		accumulatedTime += runningTime;
+	for(int i = 0; i < size(); ++i) {
+		record(CHANGE_EDIT, rows[i], -row(i).time);
+		row(i).time = 0;
+		markRow(i);
+	}
+	runningTime = 0;
+	++revision;
+	changedHeader = true;
+	checkTotals();
+}
+
+void TrackingList::addEvent(HistoryEventType type, int node, int value) {
+	if (type != HISTORY_EDIT || value != 0) {
+		HistoryEvent event = { 0, type, node, value };
+		events.push_back(event);
+	}
+}
+
+// Changes go to the undo log or, while a step is replayed, their inverses to the other log. Edits
+// of a node within a step add up, so a step holds one per node. A full log drops its oldest step
+// whole, and a step that would not fit on its own is not kept at all.
+void TrackingList::record(ChangeType type, NodeIndex node, int value, int value2) {
+	if (type == CHANGE_EDIT && value == 0)
+		return;
+	ChangeLog& log = replaying ? *replaying : undoLog;
+	if (!replaying)
+		redoLog.clear();
+	if (stepDropped)
+		return;
+	for(int i = log.size() - 1; stepOpen && type == CHANGE_EDIT && i >= 0 && log[i].type == CHANGE_EDIT; --i) {
+		if (log[i].node == node) {
+			log[i].value += value;
+			return;
+		}
+		if (log[i].first)
+			break;
+	}
+	Change change = { (schar)type, node, !stepOpen, value, value2 };
+	stepOpen = true;
+	if (log.full()) {
+		do {
+			log.pop_front();
+		} while (!log.empty() && !log.front().first);
+		if (log.empty() && !change.first) {
+			stepDropped = true;
+			return;
+		}
+	}
+	log.push(change);
+}
+
+void TrackingList::endStep() {
+	stepOpen = stepDropped = false;
+}
+
+void TrackingList::clearSteps() {
+	undoLog.clear();
+	redoLog.clear();
+	endStep();
+}
+
+bool TrackingList::undo() {
+	return replay(undoLog, redoLog);
+}
+
+bool TrackingList::redo() {
+	return replay(redoLog, undoLog);
+}
+
+// Reverts the newest step of one log, newest change first, which logs the inverse step to the
+// other. Time accrued since stays where it is; the active and selected slots stay on the rows
+// that hold their nodes.
+bool TrackingList::replay(ChangeLog& from, ChangeLog& to) {
+	endStep();
+	if (from.empty())
+		return false;
+	updateTime();
+	NodeIndex active = activeIndex1 != NULL_V ? rows[activeIndex1] : NULL_V;
+	NodeIndex selected = selectedIndex != NULL_V ? rows[selectedIndex] : NULL_V;
+	replaying = &to;
+	for(bool first = false; !first && !from.empty();) {
+		Change change = from.back();
+		from.pop_back();
+		first = change.first;
+		revert(change);
+	}
+	replaying = NULL;
+	endStep();
+	activeIndex1 = findRow(active);
+	activeIndex2 = NULL_V;
+	selectedIndex = findRow(selected);
+	++revision;
+	checkTotals();
+	return true;
+}
+
+// Undoing the newest steps first leaves every change the rows it was made on.
+void TrackingList::revert(Change const& change) {
+	int index = findRow(change.node);
+	switch(change.type) {
+		case CHANGE_EDIT:
+			if (change.node == NULL_V)
+				editAccumulated(-change.value);
+			else if (index != NULL_V && rows[index] == change.node)
+				editRow(index, -change.value);
+			break;
+		case CHANGE_MERGE:
+			if (index != NULL_V && rows[index] == change.node)
+				breakPair(index);
+			break;
+		case CHANGE_SPLIT: {
+			TrackingNode const& pair = nodes[change.node];
+			index = findRow(pair.element1);
+			if (index != NULL_V && index + 1 < size() && rows[index] == pair.element1 && buildPair(index, index + 1)) {
+				nodes[pair.element1].time = change.value;
+				nodes[pair.element2].time = change.value2;
+			}
+			break;
+		}
+	}
+}
+
+// Any row time also moves the header totals.
+void TrackingList::markRow(int index) {
+	if (changedFirst > changedLast)
+		changedFirst = changedLast = index;
+	changedFirst = min(changedFirst, index);
+	changedLast = max(changedLast, index);
+	changedHeader = true;
 }
 
+void TrackingList::clearChanges() {
+	changedFirst = 0;
+	changedLast = NULL_V;
+	changedHeader = changedLayout = false;
+}
+
+// Every leaf lies under exactly one visible row.
 int TrackingList::totalHeight() const {
-	return accumulate(begin(), end(), 0, [](int a, BaseTracking* b) { return a + b->getHeight(); });
+	return leafCount;
 }
 
 int TrackingList::totalTime() const {
@@ -362,6 +958,25 @@ int TrackingList::totalTime() const {
 }
 
 int TrackingList::totalTime(bool accumulated) const {
-	int totalTime = accumulate(begin(), end(), 0, [](int a, BaseTracking* b) { return a + b->time; });
-	return accumulated ? totalTime + accumulatedTime : totalTime;
+	return accumulated ? runningTime + accumulatedTime : runningTime;
+}
+
+bool TrackingList::totalsConsistent() const {
+	return runningTime == recomputeTime();
+}
+
+int TrackingList::recomputeTime() const {
+	int totalTime = 0;
+	for(int i = 0; i < size(); ++i)
+		totalTime += at(i)->time;
+	return totalTime;
+}
+
+// Merging keeps the sum of the visible times and splitting redistributes a pair's time without
+// changing it, so only accrual, edits and resets move the running total.
+void TrackingList::checkTotals() const {
+#ifdef TRACKER_DEBUG
+	if (!totalsConsistent())
+		app_log(APP_LOG_LEVEL_ERROR, __FILE__, __LINE__, "running total %d != %d", runningTime, recomputeTime());
+#endif
 }
@@ -1,82 +1,135 @@
-#include "pebble.hpp"
+#pragma once
 
-#include <map>
-#include <vector>
-#include <algorithm>
+#include "pebble.hpp"
+#include "containers.hpp"
+#include "history.hpp"
+#include "string_pool.hpp"
 
 #define NULL_V -1
 
 typedef signed char schar;
+typedef schar NodeIndex;
 
-class BaseTracking {
-public:
-	virtual ~BaseTracking() {};
-
-	char const* getName() const;
-	int getTime() const;
-	virtual int getPriority() const {} // = 0;
-	virtual int getHeight() const {} // = 0;
-
-	friend class TrackingList;
-
-protected:
-	char* name;
-	int time = 0;
-};
-
-class TrackingElement : public BaseTracking {
-public:
-	TrackingElement(char*, int);
-	~TrackingElement();
+// One slot of the merge hierarchy. Leaves take the first slots and every pair of the config owns
+// one of the remaining ones; parent and child links are fixed when the config is compiled, height
+// and priority are cached when a pair is built.
+struct TrackingNode {
+	int getTime() const {
+		return time;
+	}
+	int getPriority() const {
+		return priority;
+	}
+	int getHeight() const {
+		return height;
+	}
 
-	int getPriority() const;
-	int getHeight() const;
-private:
+	NameId name;
+	int time;
 	int priority;
+	NodeIndex parent;
+	NodeIndex element1;
+	NodeIndex element2;
+	schar height;
 };
 
-class TrackingPair : public BaseTracking {
-public:
-	TrackingPair(char*, BaseTracking*, BaseTracking*);
-
-	int getPriority() const;
-	int getHeight() const;
-
-	BaseTracking* element1;
-	BaseTracking* element2;
+// A time the config sets for a leaf or pair, vibrating its own pattern once the node's time
+// reaches it. Goals and budgets differ only in the pattern the config page picks for them.
+struct Goal {
+	NodeIndex node;
+	schar pattern;
+	uint16_t minutes;
 };
 
 enum TrackingListMode { NORMAL_MODE, BUILD_BREAK_MODE, FREEZE_MODE };
 
-struct CharComparator {
-	bool operator()(char const *a, char const *b) {
-		return strcmp(a, b) < 0;
-	}
+enum ChangeType { CHANGE_EDIT, CHANGE_MERGE, CHANGE_SPLIT };
+
+// One delta of the undo log. An edit moved the time of node, or of the accumulated total for
+// NULL_V, by value; a merge built the pair node; a split broke it while its elements held value
+// and value2. Replaying a change reverts it; first marks the change a step started with.
+struct Change {
+	schar type;
+	NodeIndex node;
+	bool first;
+	int value;
+	int value2;
 };
 
-class PairMap : private std::map<char*, char*, CharComparator> {
+// Pair names keyed by the joined names of their two elements, as the config page sends them.
+// Keys and names are interned in the pool the list later adds its leaf names to.
+class PairMap {
 public:
-	using map::empty;
-
-	std::pair<iterator, bool> insert(std::pair<char*, char*> pair) {
-		char* first = new char[strlen(pair.first) + 1];
-		strcpy(first, pair.first);
-		char* second = new char[strlen(pair.second) + 1];
-		strcpy(second, pair.second);
-		return std::map<char*, char*, CharComparator>::insert(std::pair<char*, char*>(first, second));
+	bool empty() const {
+		return pairs.empty();
+	}
+	int size() const {
+		return pairs.size();
 	}
+	void insert(char const*, char const*);
+
+	// A tree of TrackingList::MAX_LEAVES leaves has one pair fewer.
+	static const int CAPACITY = 63;
+
+private:
+	StringPool names;
+	FlatMap<NameId, NameId, CAPACITY> pairs;
 
 	friend class TrackingList;
 };
 
-class TrackingList : private std::vector<BaseTracking*> {
+// The visible list is a row array of node indices over a single node block sized for the leaf
+// count, so merges and splits neither allocate, follow pointers nor compare names.
+class TrackingList {
+public:
+	// A NodeIndex addresses at most 127 node slots, which a tree of 64 leaves fills.
+	static const int MAX_LEAVES = 64;
+	// The state is saved as one journal image, which holds this many leaves and pairs.
+	static const int MAX_NODES;
+
+private:
+	// The largest step, a reset of every leaf and the accumulated total, fits the log on its own,
+	// and undoing it logs as many edits.
+	static const int UNDO_CAPACITY = MAX_LEAVES + 1;
+	typedef RingBuffer<Change, UNDO_CAPACITY> ChangeLog;
+	typedef StaticVector<HistoryEvent, UNDO_CAPACITY> EventList;
+	typedef StaticVector<Goal, 16> GoalList;
+
 public:
-	TrackingList(std::vector<BaseTracking*>, PairMap&);
-	TrackingList(std::vector<BaseTracking*>, PairMap&, int, int);
+	TrackingList(int, PairMap&);
+	TrackingList(int, PairMap&, int, int);
 	~TrackingList();
 
-	using vector::size;
-	using vector::at;
+	static TrackingList* fromConfig(schar const*, int);
+	int serializeConfig(schar*, int);
+
+	void addElement(char const*, int);
+	void addPair(NodeIndex, NodeIndex, char const*);
+	void addGoal(NodeIndex, int, int);
+	bool carryOver(TrackingList&);
+
+	size_t size() const {
+		return rowCount;
+	}
+	TrackingNode const* at(int index) const {
+		return nodes + rows[index];
+	}
+	char const* getName(int index) const {
+		return possiblePairs.names.get(at(index)->name);
+	}
+	NodeIndex getNode(int index) const {
+		return rows[index];
+	}
+	// Fixed once the pairs are compiled, which loading or saving the config does.
+	NodeIndex getParent(NodeIndex node) const {
+		return nodes[node].parent;
+	}
+	char const* getNodeName(NodeIndex) const;
+	GoalList const& getGoals() const {
+		return goals;
+	}
+	int getNodeTime(NodeIndex) const;
+	bool accruesTo(NodeIndex) const;
 
 	TrackingListMode getMode() const {
 		return mode;
@@ -96,10 +149,24 @@ public:
 	int getTotalAccHours() const {
 		return totalAccHours;
 	}
+	int getNodeCapacity() const {
+		return nodeCapacity;
+	}
+	int getUsedNodes() const {
+		return usedNodes;
+	}
+	int getNodeHighWater() const {
+		return nodeHighWater;
+	}
+	// Bumped by every change that the saved time stamp cannot replay, i.e. everything but accrual.
+	int getRevision() const {
+		return revision;
+	}
 
-	int getBinarySize();
-	schar* serialize();
-	void deserialize(schar*);
+	int getBinarySize() const;
+	int serialize(schar*, int) const;
+	bool deserialize(schar const*, int);
+	bool deserializeLegacy(schar const*, int);
 
 	void switchMode(TrackingListMode);
 	void resetIndex();
@@ -117,6 +184,7 @@ public:
 	bool buildAll();
 	bool breakPair();
 	bool breakPair(int);
+	bool breakTree(int);
 	bool breakAll();
 
 	int updateTime();
@@ -125,19 +193,116 @@ public:
 	void resetSelectedTime();
 	void resetTime(bool);
 
+	// Resets, edits, merges and splits are logged as deltas in RAM so that they can be undone and
+	// redone; what changed since the last endStep() is one step. A new change drops the redo log
+	// and the oldest steps go once the log is full.
+	bool canUndo() const {
+		return !undoLog.empty();
+	}
+	bool canRedo() const {
+		return !redoLog.empty();
+	}
+	bool undo();
+	bool redo();
+	void endStep();
+
 	int totalHeight() const;
 	int totalTime() const;
 	int totalTime(bool) const;
+	bool totalsConsistent() const;
+
+	// What changed on screen since the last clearChanges(): the rows whose time moved, the header
+	// totals, and whether merges, splits or a restore replaced the rows themselves.
+	bool rowChanged(int index) const {
+		return index >= changedFirst && index <= changedLast;
+	}
+	bool headerChanged() const {
+		return changedHeader;
+	}
+	bool layoutChanged() const {
+		return changedLayout;
+	}
+	void clearChanges();
+
+	// Edits and resets since the last clearEvents(), for the history log. Starts and stops are
+	// not listed; they follow from the active node.
+	EventList const& getEvents() const {
+		return events;
+	}
+	void clearEvents() {
+		events.clear();
+	}
+	NodeIndex getActiveNode() const {
+		return mode == NORMAL_MODE && activeIndex1 != NULL_V ? rows[activeIndex1] : NULL_V;
+	}
 
 private:
+	TrackingNode& row(int index) {
+		return nodes[rows[index]];
+	}
+	void compilePairs();
+	NodeIndex findNode(char const*) const;
+	int findRow(char const*) const;
+	int findRow(NodeIndex) const;
+	bool contains(NodeIndex, NodeIndex) const;
+	void markRow(int);
+	void addEvent(HistoryEventType, int, int);
+	void editRow(int, int);
+	void editAccumulated(int);
+	void record(ChangeType, NodeIndex, int, int = 0);
+	void clearSteps();
+	void insertRow(int, NodeIndex);
+	void eraseRow(int);
+
+	int writeNode(schar*, NodeIndex) const;
+	void clear();
+
+	static int shiftTime(TrackingNode&, int);
+	static void shareTime(TrackingNode const&, TrackingNode*, TrackingNode*);
+	int splitNode(NodeIndex, NodeIndex*);
+	bool replay(ChangeLog&, ChangeLog&);
+	void revert(Change const&);
+	int recomputeTime() const;
+	void checkTotals() const;
+
 	static const int HEADER_SIZE;
+	static const int RECORD_SIZE;
+	static const int CHECKSUM_SIZE;
+	static const schar BINARY_VERSION;
+	static const int LEGACY_HEADER_SIZE;
+	static const int CONFIG_HEADER_SIZE;
+	static const int GOAL_SIZE;
+	static const schar CONFIG_VERSION;
 	PairMap possiblePairs;
+	GoalList goals;
+	TrackingNode* nodes;
+	NodeIndex* rows;
+	int rowCount = 0;
+	int leafCount = 0;
+	int leafCapacity;
+	int nodeCapacity;
+	int pairCount = 0;
+	int usedNodes = 0;
+	int nodeHighWater = 0;
+	bool pairsCompiled = false;
 	TrackingListMode mode = NORMAL_MODE;
 	int selectedIndex = NULL_V;
 	int activeIndex1 = NULL_V;
 	int activeIndex2 = NULL_V;
 	int lastTimeStamp = NULL_V;
+	int revision = 0;
+	int changedFirst = 0;
+	int changedLast = NULL_V;
+	bool changedHeader = true;
+	bool changedLayout = true;
+	EventList events;
+	ChangeLog undoLog;
+	ChangeLog redoLog;
+	ChangeLog* replaying = NULL;
+	bool stepOpen = false;
+	bool stepDropped = false;
 	int accumulatedTime = 0;
+	int runningTime = 0;
 	int totalHours = 8;
 	int totalAccHours = 40;
 };
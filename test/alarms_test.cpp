@@ -0,0 +1,144 @@
+#include "alarms.hpp"
+#include "host.hpp"
+#include "test.hpp"
+
+static const int HOUR = 60 * 60;
+static const int START = 1767600000;
+
+// Slots are hard 0, simple 1 and education 2; work 3 pairs the first two and main 4 pairs work
+// with education.
+static TrackingList* createList() {
+	PairMap pairs;
+	pairs.insert("hardsimple", "work");
+	pairs.insert("workeducation", "main");
+	TrackingList* list = new TrackingList(3, pairs, 2, 3);
+	list->addElement("hard", 0);
+	list->addElement("simple", 0);
+	list->addElement("education", 1);
+	schar buffer[PERSIST_DATA_MAX_LENGTH];
+	list->serializeConfig(buffer, sizeof(buffer));
+	return list;
+}
+
+static void setTime(TrackingList* list, int index, int seconds) {
+	list->resetIndex();
+	list->incIndex(index + 1);
+	list->resetSelectedTime();
+	list->addTime(seconds);
+}
+
+static void activate(TrackingList* list, int index) {
+	list->resetIndex();
+	list->incIndex(index + 1);
+	list->switchIndex();
+}
+
+static int now() {
+	return time(0L);
+}
+
+static void testNothingAccrues() {
+	host::reset(START);
+	TrackingList* list = createList();
+	Alarms alarms;
+	CHECK(!alarms.isPlanned(*list));
+	alarms.plan(*list, now());
+	CHECK(alarms.isPlanned(*list));
+	CHECK_EQ(alarms.getNextDeadline(), NULL_V);
+	CHECK_EQ(alarms.fire(now() + 10 * HOUR), NULL_V);
+	delete list;
+}
+
+// Hourly on the row, at every two hours of the day's and the accumulated total and at every three
+// of the accumulated total. Alarms due together vibrate the strongest.
+static void testThresholds() {
+	host::reset(START);
+	TrackingList* list = createList();
+	setTime(list, 0, HOUR / 2);
+	setTime(list, 1, HOUR + 600);
+	activate(list, 0);
+	CHECK_EQ(list->totalTime(), 6000);
+	Alarms alarms;
+	alarms.plan(*list, now());
+	CHECK_EQ(alarms.getNextDeadline(), START + 1200);
+	CHECK_EQ(alarms.fire(START + 1199), NULL_V);
+	CHECK_EQ(alarms.fire(START + 1200), ALARM_TOTAL);
+	CHECK_EQ(alarms.getNextDeadline(), START + 1800);
+	CHECK_EQ(alarms.fire(START + 1800), ALARM_HOUR);
+	CHECK_EQ(alarms.getNextDeadline(), START + 4800);
+	CHECK_EQ(alarms.fire(START + 4800), ALARM_ACC_TOTAL);
+	CHECK_EQ(alarms.getNextDeadline(), START + 5400);
+	CHECK_EQ(alarms.fire(START + 15600), ALARM_ACC_TOTAL);
+	CHECK_EQ(alarms.getNextDeadline(), START + 16200);
+	delete list;
+}
+
+// Goals fire once, on leaves and on split pairs alike, and only for nodes the slot accrues to.
+static void testGoals() {
+	host::reset(START);
+	TrackingList* list = createList();
+	setTime(list, 0, HOUR / 2);
+	activate(list, 1);
+	list->addGoal(3, 60, ALARM_GOAL);
+	list->addGoal(1, 80, ALARM_BUDGET);
+	list->addGoal(2, 10, ALARM_GOAL);
+	Alarms alarms;
+	alarms.plan(*list, now());
+	CHECK_EQ(alarms.fire(START + 1800), ALARM_GOAL);
+	CHECK_EQ(alarms.fire(START + 3600), ALARM_HOUR);
+	CHECK_EQ(alarms.fire(START + 4800), ALARM_BUDGET);
+	CHECK_EQ(alarms.fire(START + 5400), ALARM_TOTAL);
+	CHECK_EQ(alarms.getNextDeadline(), START + 7200);
+	CHECK_EQ(alarms.fire(START + 7200), ALARM_HOUR);
+	delete list;
+}
+
+// A node merged into a larger row has no time of its own, and a goal already reached stays quiet.
+// A pattern the watch does not know vibrates as a goal.
+static void testHiddenAndReachedGoals() {
+	host::reset(START);
+	TrackingList* list = createList();
+	setTime(list, 0, 600);
+	CHECK(list->buildPair(0, 1));
+	CHECK_EQ(list->getActiveIndex(), 0);
+	list->addGoal(0, 30, ALARM_BUDGET);
+	list->addGoal(4, 5, ALARM_BUDGET);
+	list->addGoal(4, 30, 9);
+	CHECK_EQ(list->getNodeTime(0), NULL_V);
+	CHECK_EQ(list->getNodeTime(4), 600);
+	Alarms alarms;
+	alarms.plan(*list, now());
+	CHECK_EQ(alarms.getNextDeadline(), START + 1200);
+	CHECK_EQ(alarms.fire(START + 1200), ALARM_GOAL);
+	CHECK_EQ(alarms.getNextDeadline(), START + 3000);
+	delete list;
+}
+
+// Accrual keeps the plan; switching the slot asks for a new one.
+static void testReplanOnRevision() {
+	host::reset(START);
+	TrackingList* list = createList();
+	activate(list, 0);
+	Alarms alarms;
+	alarms.plan(*list, now());
+	host::advance(HOUR / 2);
+	list->updateTime();
+	CHECK(alarms.isPlanned(*list));
+	activate(list, 2);
+	CHECK(!alarms.isPlanned(*list));
+	alarms.plan(*list, now());
+	CHECK_EQ(alarms.getNextDeadline(), START + HOUR / 2 + HOUR);
+	alarms.clear();
+	CHECK(!alarms.isPlanned(*list));
+	CHECK_EQ(alarms.getNextDeadline(), NULL_V);
+	delete list;
+}
+
+int main() {
+	RUN(testNothingAccrues);
+	RUN(testThresholds);
+	RUN(testGoals);
+	RUN(testHiddenAndReachedGoals);
+	RUN(testReplanOnRevision);
+	return failures != 0;
+}
@@ -0,0 +1,89 @@
+#include "containers.hpp"
+#include "test.hpp"
+
+static void testStaticVector() {
+	StaticVector<int, 4> v;
+	CHECK(v.push_back(1));
+	CHECK(v.push_back(3));
+	CHECK(v.insert(1, 2));
+	CHECK(v.insert(0, 0));
+	CHECK(v.full());
+	CHECK(!v.push_back(4));
+	for (int i = 0; i < v.size(); ++i)
+		CHECK_EQ(v[i], i);
+	v.erase(1);
+	CHECK_EQ(v.size(), 3);
+	CHECK_EQ(v[1], 2);
+	int sum = 0;
+	for (int item : v)
+		sum += item;
+	CHECK_EQ(sum, 5);
+}
+
+static void testFlatMap() {
+	FlatMap<int, char, 4> map;
+	CHECK(map.insert(30, 'c'));
+	CHECK(map.insert(10, 'a'));
+	CHECK(map.insert(20, 'b'));
+	CHECK(map.insert(10, 'x'));
+	CHECK_EQ(map.size(), 3);
+	CHECK_EQ(*map.find(10), 'a');
+	CHECK_EQ(map[1].key, 20);
+	CHECK_EQ(map[2].value, 'c');
+	CHECK(map.find(15) == NULL);
+	CHECK(map.insert(40, 'd'));
+	CHECK(!map.insert(5, 'e'));
+	CHECK(map.find(5) == NULL);
+}
+
+static void testRingBuffer() {
+	RingBuffer<int, 3> ring;
+	for (int i = 1; i <= 5; ++i)
+		ring.push(i);
+	CHECK_EQ(ring.size(), 3);
+	CHECK_EQ(ring.front(), 3);
+	CHECK_EQ(ring[2], 5);
+	ring.pop_back();
+	CHECK_EQ(ring.back(), 4);
+	ring.pop_front();
+	CHECK_EQ(ring.size(), 1);
+	CHECK_EQ(ring[0], 4);
+	ring.push(6);
+	ring.push(7);
+	ring.push(8);
+	CHECK_EQ(ring.front(), 6);
+	CHECK_EQ(ring.back(), 8);
+}
+
+static void testPriorityQueue() {
+	PriorityQueue<int, 8> queue;
+	int items[] = { 5, 3, 8, 1, 9, 2, 7, 4 };
+	for (int item : items)
+		CHECK(queue.push(item));
+	CHECK(queue.full());
+	CHECK(!queue.push(0));
+	CHECK_EQ(queue.top(), 1);
+	int last = 0;
+	for (int i = 0; i < 4; ++i) {
+		CHECK(queue.top() > last);
+		last = queue.top();
+		queue.pop();
+	}
+	queue.push(6);
+	queue.push(0);
+	CHECK_EQ(queue.top(), 0);
+	int expected[] = { 0, 5, 6, 7, 8, 9 };
+	for (int item : expected) {
+		CHECK_EQ(queue.top(), item);
+		queue.pop();
+	}
+	CHECK(queue.empty());
+}
+
+int main() {
+	RUN(testStaticVector);
+	RUN(testFlatMap);
+	RUN(testRingBuffer);
+	RUN(testPriorityQueue);
+	return failures != 0;
+}
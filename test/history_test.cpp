@@ -0,0 +1,99 @@
+#include "history.hpp"
+#include "host.hpp"
+#include "test.hpp"
+
+#include <vector>
+
+using namespace std;
+
+static const uint32_t KEY = 200;
+
+static vector<HistoryEvent> readAll(History& history) {
+	vector<HistoryEvent> events;
+	HistoryReader reader(history);
+	HistoryEvent event;
+	while (reader.next(event))
+		events.push_back(event);
+	return events;
+}
+
+static void testRecordAndReload() {
+	host::reset(1000);
+	History history(KEY);
+	history.record(HISTORY_START, 2, 0);
+	host::advance(90);
+	history.record(HISTORY_EDIT, 2, -600);
+	history.record(HISTORY_EDIT, -1, 300);
+	host::advance(20000);
+	history.record(HISTORY_RESET, -1, 1);
+	history.record(HISTORY_STOP, 2, 0);
+	CHECK_EQ(host::stats().persistWrites, 0);
+	CHECK_EQ(readAll(history).size(), 5);
+
+	CHECK(history.flush());
+	CHECK_EQ(host::stats().persistWrites, 1);
+	CHECK_EQ(host::stats().persistBytesWritten, 6 + 2 + 5 + 4 + 5 + 2);
+	CHECK(!history.hasPending());
+
+	History reloaded(KEY);
+	host::advance(5);
+	reloaded.record(HISTORY_START, 0, 0);
+	vector<HistoryEvent> events = readAll(reloaded);
+	CHECK_EQ(events.size(), 6);
+	CHECK_EQ(events[0].time, 1000);
+	CHECK_EQ(events[0].type, HISTORY_START);
+	CHECK_EQ(events[1].time, 1090);
+	CHECK_EQ(events[1].value, -600);
+	CHECK_EQ(events[2].node, -1);
+	CHECK_EQ(events[3].type, HISTORY_RESET);
+	CHECK_EQ(events[3].value, 1);
+	CHECK_EQ(events[4].node, 2);
+	CHECK_EQ(events[5].time, 21095);
+	CHECK_EQ(events[5].node, 0);
+}
+
+static void testEviction() {
+	host::reset(1000);
+	History history(KEY);
+	int records = 0;
+	for (; host::persistUsed() < History::PAGES * History::PAGE_SIZE - History::PAGE_SIZE / 2; ++records) {
+		history.record(HISTORY_START, records % 6, 0);
+		host::advance(60);
+		if (records % 10 == 9)
+			history.flush();
+	}
+	for (int i = 0; i < 200; ++i, ++records) {
+		history.record(HISTORY_START, records % 6, 0);
+		host::advance(60);
+	}
+	history.flush();
+	CHECK(host::persistUsed() <= History::PAGES * History::PAGE_SIZE);
+
+	vector<HistoryEvent> events = readAll(history);
+	CHECK(events.size() < records);
+	CHECK_EQ(events.back().time, 1000 + 60 * (records - 1));
+	CHECK_EQ(events.back().node, (records - 1) % 6);
+	for (size_t i = 1; i < events.size(); ++i)
+		CHECK_EQ(events[i].time - events[i - 1].time, 60);
+	History reloaded(KEY);
+	CHECK_EQ(readAll(reloaded).size(), events.size());
+}
+
+static void testClear() {
+	host::reset(1000);
+	History history(KEY);
+	history.record(HISTORY_START, 1, 0);
+	history.flush();
+	history.clear();
+	CHECK_EQ(host::persistUsed(), 0);
+	CHECK_EQ(readAll(history).size(), 0);
+	History reloaded(KEY);
+	CHECK_EQ(readAll(reloaded).size(), 0);
+}
+
+int main() {
+	RUN(testRecordAndReload);
+	RUN(testEviction);
+	RUN(testClear);
+	return failures != 0;
+}
@@ -0,0 +1,121 @@
+#include "journal.hpp"
+#include "host.hpp"
+#include "test.hpp"
+
+using namespace std;
+
+static const uint32_t KEY = 100;
+static const int IMAGE_SIZE = 70;
+
+static bool loads(uint8_t const* expected, int size) {
+	Journal journal(KEY);
+	uint8_t buffer[PERSIST_DATA_MAX_LENGTH];
+	return journal.load(buffer, sizeof(buffer)) == size && memcmp(buffer, expected, size) == 0;
+}
+
+static void fill(uint8_t* image, int size) {
+	for (int i = 0; i < size; ++i)
+		image[i] = rand();
+}
+
+static void testCheckpointAndReplay() {
+	host::reset();
+	srand(1);
+	uint8_t image[PERSIST_DATA_MAX_LENGTH];
+	fill(image, IMAGE_SIZE);
+	Journal journal(KEY);
+	CHECK(journal.append(image, IMAGE_SIZE));
+	CHECK_EQ(journal.getGeneration(), 1);
+	CHECK_EQ(journal.getPageCount(), 0);
+	CHECK(loads(image, IMAGE_SIZE));
+
+	host::resetStats();
+	CHECK(journal.append(image, IMAGE_SIZE));
+	CHECK_EQ(host::stats().persistWrites, 0);
+
+	image[3] ^= 1;
+	image[5] ^= 1;
+	image[40] ^= 1;
+	CHECK(journal.append(image, IMAGE_SIZE));
+	CHECK_EQ(journal.getPageCount(), 1);
+	CHECK_EQ(host::stats().persistWrites, 1);
+	CHECK_EQ(host::stats().persistBytesWritten, 3 + 2 + 3 + 2 + 1);
+	CHECK(loads(image, IMAGE_SIZE));
+}
+
+static void testFold() {
+	host::reset();
+	srand(2);
+	uint8_t image[PERSIST_DATA_MAX_LENGTH];
+	fill(image, IMAGE_SIZE);
+	Journal journal(KEY);
+	journal.append(image, IMAGE_SIZE);
+	int pages = 0;
+	for (int i = 0; journal.getGeneration() == 1; ++i) {
+		pages = max(pages, journal.getPageCount());
+		image[i % IMAGE_SIZE] ^= 0x55;
+		image[(i * 7 + 30) % IMAGE_SIZE] ^= 0x55;
+		CHECK(journal.append(image, IMAGE_SIZE));
+		CHECK(loads(image, IMAGE_SIZE));
+	}
+	CHECK_EQ(pages, Journal::PAGES);
+	CHECK_EQ(journal.getPageCount(), 0);
+
+	image[0] ^= 1;
+	journal.append(image, IMAGE_SIZE);
+	fill(image, IMAGE_SIZE);
+	journal.append(image, IMAGE_SIZE);
+	CHECK_EQ(journal.getGeneration(), 3);
+	CHECK(loads(image, IMAGE_SIZE));
+}
+
+static void testResize() {
+	host::reset();
+	srand(3);
+	uint8_t image[PERSIST_DATA_MAX_LENGTH];
+	fill(image, IMAGE_SIZE + 10);
+	Journal journal(KEY);
+	journal.append(image, IMAGE_SIZE);
+	journal.append(image, IMAGE_SIZE + 10);
+	CHECK_EQ(journal.getGeneration(), 1);
+	CHECK(loads(image, IMAGE_SIZE + 10));
+	image[IMAGE_SIZE - 20] ^= 1;
+	journal.append(image, IMAGE_SIZE - 20);
+	CHECK_EQ(journal.getGeneration(), 1);
+	CHECK(loads(image, IMAGE_SIZE - 20));
+	CHECK(!journal.append(image, Journal::MAX_IMAGE_SIZE + 1));
+}
+
+static void testTornJournal() {
+	host::reset();
+	srand(4);
+	uint8_t image[PERSIST_DATA_MAX_LENGTH];
+	fill(image, IMAGE_SIZE);
+	Journal journal(KEY);
+	journal.append(image, IMAGE_SIZE);
+	for (int i = 0; journal.getPageCount() < 2; ++i) {
+		fill(image + 10 * (i % 6), 8);
+		journal.append(image, IMAGE_SIZE);
+	}
+	persist_delete(KEY + Journal::CHECKPOINT_SLOTS + 1);
+	CHECK(!loads(image, IMAGE_SIZE));
+
+	Journal reloaded(KEY);
+	uint8_t buffer[PERSIST_DATA_MAX_LENGTH];
+	CHECK_EQ(reloaded.load(buffer, sizeof(buffer)), IMAGE_SIZE);
+	CHECK_EQ(reloaded.getPageCount(), 1);
+	CHECK(reloaded.append(image, IMAGE_SIZE));
+	CHECK(loads(image, IMAGE_SIZE));
+
+	reloaded.clear();
+	CHECK_EQ(Journal(KEY).load(buffer, sizeof(buffer)), 0);
+	CHECK_EQ(host::persistUsed(), 0);
+}
+
+int main() {
+	RUN(testCheckpointAndReplay);
+	RUN(testFold);
+	RUN(testResize);
+	RUN(testTornJournal);
+	return failures != 0;
+}
@@ -0,0 +1,88 @@
+#include "rollup.hpp"
+#include "host.hpp"
+#include "test.hpp"
+
+static const int DAY = Rollup::SECONDS_PER_DAY;
+static const int HOUR = 60 * 60;
+static const int START = 20458 * DAY; // a Monday
+
+static TrackingList* createList() {
+	PairMap pairs;
+	pairs.insert("hardsimple", "work");
+	pairs.insert("workeducation", "main");
+	TrackingList* list = new TrackingList(3, pairs);
+	list->addElement("hard", 0);
+	list->addElement("simple", 0);
+	list->addElement("education", 1);
+	schar buffer[PERSIST_DATA_MAX_LENGTH];
+	list->serializeConfig(buffer, sizeof(buffer));
+	return list;
+}
+
+static void apply(Rollup& rollup, int time, HistoryEventType type, int node, int value) {
+	HistoryEvent event = { time, type, node, value };
+	rollup.apply(event);
+}
+
+static void testDaysAndAncestors() {
+	TrackingList* list = createList();
+	NodeIndex work = list->getParent(0);
+	NodeIndex main = list->getParent(work);
+	CHECK(work != NULL_V && main != NULL_V);
+	Rollup rollup(*list, 0);
+	int day = rollup.getDay(START);
+
+	apply(rollup, START + 22 * HOUR, HISTORY_START, 0, 0);
+	apply(rollup, START + 26 * HOUR, HISTORY_START, 2, 0);
+	apply(rollup, START + 27 * HOUR, HISTORY_EDIT, 1, 600);
+	apply(rollup, START + 28 * HOUR, HISTORY_STOP, 2, 0);
+	apply(rollup, START + 29 * HOUR, HISTORY_EDIT, NULL_V, 5000);
+	CHECK_EQ(rollup.getLastDay(), day + 1);
+
+	CHECK_EQ(rollup.getTime(0, day, day), 2 * HOUR);
+	CHECK_EQ(rollup.getTime(0, day + 1, day + 1), 2 * HOUR);
+	CHECK_EQ(rollup.getTime(1, day, day + 1), 600);
+	CHECK_EQ(rollup.getTime(work, day, day + 1), 4 * HOUR + 600);
+	CHECK_EQ(rollup.getTime(main, day + 1, day + 1), 4 * HOUR + 600);
+	CHECK_EQ(rollup.getTime(NULL_V, day - 7, day + 7), 6 * HOUR + 600);
+
+	apply(rollup, START + 3 * DAY, HISTORY_START, work, 0);
+	rollup.advance(START + 3 * DAY + HOUR);
+	CHECK_EQ(rollup.getTime(work, day + 3, day + 3), HOUR);
+	CHECK_EQ(rollup.getTime(0, day + 3, day + 3), 0);
+	CHECK_EQ(rollup.getTime(main, day + 2, day + 3), HOUR);
+	delete list;
+}
+
+static void testWindow() {
+	TrackingList* list = createList();
+	Rollup rollup(*list, 0);
+	int day = rollup.getDay(START);
+	for (int i = 0; i < 30; ++i) {
+		apply(rollup, START + i * DAY, HISTORY_START, 2, 0);
+		apply(rollup, START + i * DAY + HOUR, HISTORY_STOP, 2, 0);
+	}
+	CHECK_EQ(rollup.getTime(2, day + 29, day + 29), HOUR);
+	CHECK_EQ(rollup.getTime(2, day + 23, day + 29), 7 * HOUR);
+	CHECK_EQ(rollup.getTime(2, day, day + 29), (Rollup::DAYS - 1) * HOUR);
+	CHECK_EQ(rollup.getTime(2, day + 30, day + 40), 0);
+	delete list;
+}
+
+static void testLocalMidnight() {
+	TrackingList* list = createList();
+	Rollup rollup(*list, DAY - 2 * HOUR);
+	int day = rollup.getDay(START + 21 * HOUR);
+	apply(rollup, START + 21 * HOUR, HISTORY_START, 0, 0);
+	rollup.advance(START + 24 * HOUR);
+	CHECK_EQ(rollup.getTime(0, day, day), HOUR);
+	CHECK_EQ(rollup.getTime(0, day + 1, day + 1), 2 * HOUR);
+	delete list;
+}
+
+int main() {
+	RUN(testDaysAndAncestors);
+	RUN(testWindow);
+	RUN(testLocalMidnight);
+	return failures != 0;
+}
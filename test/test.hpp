@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdio.h>
+
+static int failures = 0;
+
+#define CHECK(condition) do { \
+	if (!(condition)) { \
+		++failures; \
+		fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+	} \
+} while (0)
+
+#define CHECK_EQ(actual, expected) do { \
+	long long a = (long long)(actual), e = (long long)(expected); \
+	if (a != e) { \
+		++failures; \
+		fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n", __FILE__, __LINE__, #actual, #expected, a, e); \
+	} \
+} while (0)
+
+#define RUN(test) do { \
+	int before = failures; \
+	test(); \
+	fprintf(stderr, "%s %s\n", failures == before ? "PASS" : "FAIL", #test); \
+} while (0)
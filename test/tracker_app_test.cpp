@@ -0,0 +1,920 @@
+#include "host.hpp"
+#include "journal.hpp"
+#include "history.hpp"
+#include "history_export.hpp"
+#include "config_receiver.hpp"
+#include "diagnostics.hpp"
+#include "alarms.hpp"
+#include "test.hpp"
+
+#include <algorithm>
+
+using namespace std;
+
+int app_main(void);
+TrackingList const* getTrackingList();
+
+static const time_t MONDAY_MORNING = 1767600000; // 2026-01-05 08:00 UTC
+
+static bool drawn(char const* text) {
+	const vector<string>& frame = host::frame();
+	return find(frame.begin(), frame.end(), text) != frame.end();
+}
+
+// Up from the header goes to the last slot and down from there to the history entry below it.
+static void openHistoryView() {
+	host::click(BUTTON_ID_UP);
+	host::click(BUTTON_ID_DOWN);
+	host::click(BUTTON_ID_SELECT);
+}
+
+// The model loads right after the first frame, so the loop starts once it is in.
+static void launch(function<void()> loop) {
+	host::setEventLoop([loop] {
+		host::advanceMs(0);
+		loop();
+	});
+	app_main();
+	host::terminate();
+}
+
+static void testFirstLaunch() {
+	host::reset(MONDAY_MORNING);
+	launch([] {
+		CHECK(drawn("8:00"));
+		CHECK(drawn("hard"));
+		CHECK(drawn("distractions"));
+		CHECK_EQ(host::frame().size(), 2 + 2 * 6);
+	});
+}
+
+static void testTrackingAndRestore() {
+	host::reset(MONDAY_MORNING);
+	launch([] {
+		host::click(BUTTON_ID_DOWN);
+		host::click(BUTTON_ID_SELECT);
+		host::resetStats();
+		host::advance(60 * 60);
+		CHECK(drawn("9:00"));
+		CHECK(drawn("1:00"));
+		CHECK_EQ(host::vibes().size(), 1);
+		CHECK(host::stats().renders >= 60);
+		host::click(BUTTON_ID_BACK);
+		host::click(BUTTON_ID_BACK);
+		CHECK(!host::running());
+	});
+	CHECK(!host::persistHas(0));
+
+	host::advance(30 * 60);
+	launch([] {
+		CHECK(drawn("1:30"));
+		host::advance(30 * 60);
+		CHECK(drawn("2:00"));
+	});
+}
+
+// A state the first versions saved to key 0: hard and simple merged into work and active since
+// the launch, an hour of it on hard, half an hour on simple, 10 minutes on optimization and an
+// hour accumulated before the last reset.
+static const vector<uint8_t> LEGACY_STATE = {
+	0, 0, 0, 128, 111, 91, 105, 16, 14, 0, 0,
+	16, 14, 0, 0, ',',
+	8, 7, 0, 0, ')',
+	0, 0, 0, 0, ',',
+	0, 0, 0, 0, ',',
+	88, 2, 0, 0, ',',
+	0, 0, 0, 0, ','
+};
+
+// The old state is moved into the journal once and keeps accruing; key 0 is gone after the first
+// launch.
+static void testLegacyState() {
+	host::reset(MONDAY_MORNING);
+	host::persistSet(0, LEGACY_STATE);
+	host::advance(30 * 60);
+	launch([] {
+		CHECK(drawn("work"));
+		CHECK(!drawn("hard"));
+		CHECK(drawn("2:00"));
+		CHECK(drawn("2:10/3:10"));
+		CHECK_EQ(getTrackingList()->getActiveIndex(), 0);
+	});
+	CHECK(!host::persistHas(0));
+	launch([] {
+		CHECK(drawn("work"));
+		CHECK(drawn("2:10/3:10"));
+	});
+}
+
+// Key 0 left next to a journal is stale, say an undo snapshot taken before a reset, and never
+// comes back.
+static void testStaleLegacyState() {
+	host::reset(MONDAY_MORNING);
+	launch([] {
+		host::click(BUTTON_ID_DOWN);
+		host::click(BUTTON_ID_SELECT);
+		host::advance(2 * 60 * 60);
+		host::click(BUTTON_ID_BACK);
+		host::longClick(BUTTON_ID_SELECT);
+		CHECK(drawn("0:00/2:00"));
+	});
+	host::persistSet(0, LEGACY_STATE);
+	launch([] {
+		CHECK(drawn("0:00/2:00"));
+		CHECK(!drawn("work"));
+	});
+	CHECK(!host::persistHas(0));
+}
+
+static void testPowerLoss() {
+	host::reset(MONDAY_MORNING);
+	launch([] {
+		host::click(BUTTON_ID_DOWN);
+		host::click(BUTTON_ID_SELECT);
+		host::advance(10);
+		host::click(BUTTON_ID_DOWN);
+		host::click(BUTTON_ID_SELECT);
+		host::advance(60 * 60);
+		host::click(BUTTON_ID_DOWN);
+		host::click(BUTTON_ID_SELECT);
+		host::powerLoss();
+	});
+	launch([] {
+		CHECK(drawn("0:00"));
+		CHECK(drawn("1:00"));
+		host::advance(30 * 60);
+		CHECK(drawn("1:30"));
+	});
+}
+
+static void testGlanceWritesNothing() {
+	host::reset(MONDAY_MORNING);
+	launch([] {
+		host::click(BUTTON_ID_DOWN);
+		host::click(BUTTON_ID_SELECT);
+		host::click(BUTTON_ID_BACK);
+	});
+	for (int i = 0; i < 10; ++i) {
+		host::resetStats();
+		host::advance(15 * 60);
+		launch([] {
+			CHECK(drawn("hard"));
+		});
+		CHECK_EQ(host::stats().persistWrites, 0);
+	}
+	launch([] {
+		CHECK(drawn("2:30"));
+	});
+}
+
+static void testHeaderBeforeModel() {
+	host::reset(MONDAY_MORNING);
+	launch([] {
+		host::click(BUTTON_ID_DOWN);
+		host::click(BUTTON_ID_SELECT);
+		host::advance(60 * 60);
+	});
+	host::advance(30 * 60);
+	host::setEventLoop([] {
+		CHECK_EQ(host::frame().size(), 2);
+		CHECK(drawn("9:30"));
+		CHECK(drawn("1:30"));
+		host::resetStats();
+		host::advanceMs(0);
+		CHECK(host::stats().persistReads <= 2 + Journal::CHECKPOINT_SLOTS + Journal::PAGES);
+		CHECK_EQ(host::frame().size(), 2 + 2 * 6);
+		CHECK(drawn("1:30"));
+	});
+	app_main();
+	host::terminate();
+}
+
+static void testLegacyConfig() {
+	host::reset(MONDAY_MORNING);
+	persist_write_string(1, "readingwriting");
+	persist_write_string(2, "desk");
+	persist_write_string(-1, "reading");
+	persist_write_int(-2, 1);
+	persist_write_string(-3, "writing");
+	persist_write_int(-4, 1);
+	persist_write_int(1000, 6);
+	persist_write_int(2000, 30);
+	launch([] {
+		CHECK(drawn("writing"));
+		CHECK_EQ(host::frame().size(), 2 + 2 * 2);
+	});
+	CHECK(!host::persistHas(1));
+	CHECK(!host::persistHas(-1));
+	CHECK(!host::persistHas(1000));
+	launch([] {
+		CHECK(drawn("reading"));
+		host::click(BUTTON_ID_SELECT);
+		host::longClick(BUTTON_ID_UP);
+		CHECK(drawn("desk"));
+	});
+}
+
+// Legacy slots past the most a list can hold are left out.
+static void testLegacyConfigTooManyLeaves() {
+	host::reset(MONDAY_MORNING);
+	char name[2] = { 0, 0 };
+	for (int i = 0; i < TrackingList::MAX_LEAVES + 6; ++i) {
+		name[0] = '0' + i;
+		persist_write_string(-2 * i - 1, name);
+		persist_write_int(-2 * i - 2, 0);
+	}
+	// The four default pairs take their share of the state.
+	launch([] {
+		CHECK_EQ(getTrackingList()->size(), TrackingList::MAX_NODES - 4);
+	});
+	CHECK(!host::persistHas(-1));
+	launch([] {
+		CHECK_EQ(getTrackingList()->size(), TrackingList::MAX_NODES - 4);
+	});
+}
+
+static void testHistory() {
+	host::reset(MONDAY_MORNING);
+	launch([] {
+		host::click(BUTTON_ID_DOWN);
+		host::click(BUTTON_ID_SELECT);
+		host::advance(60);
+		CHECK(!host::persistHas(5000));
+		host::advance(5 * 60);
+		CHECK(host::persistHas(5000));
+		host::click(BUTTON_ID_SELECT);
+		host::longClick(BUTTON_ID_SELECT);
+		host::click(BUTTON_ID_UP);
+	});
+	History saved(5000);
+	HistoryReader reader(saved);
+	HistoryEvent event;
+	CHECK(reader.next(event) && event.type == HISTORY_START && event.node == 0);
+	CHECK(reader.next(event) && event.type == HISTORY_STOP && event.time == MONDAY_MORNING + 6 * 60);
+	CHECK(reader.next(event) && event.type == HISTORY_EDIT && event.node == 0 && event.value == 60 * 60);
+	CHECK(!reader.next(event));
+}
+
+static void testHistoryView() {
+	host::reset(MONDAY_MORNING);
+	launch([] {
+		host::click(BUTTON_ID_DOWN);
+		host::click(BUTTON_ID_SELECT);
+		host::advance(2 * 60 * 60);
+	});
+	host::advance(22 * 60 * 60);
+	launch([] {
+		host::advance(60 * 60);
+		host::click(BUTTON_ID_BACK);
+		openHistoryView();
+		CHECK(drawn("today"));
+		CHECK(drawn("9:00"));
+		CHECK(drawn("0:00"));
+		CHECK_EQ(host::frame().size(), 2 + 2 * 6);
+		host::advance(30 * 60);
+		CHECK(drawn("9:30"));
+		host::click(BUTTON_ID_UP);
+		CHECK(drawn("week"));
+		CHECK(drawn("25:30"));
+		host::click(BUTTON_ID_BACK);
+		CHECK(drawn("hard"));
+		CHECK(drawn("25:30"));
+		CHECK(!drawn("today"));
+	});
+}
+
+// The history entry sits below the last slot. Down from the last slot selects it and down again
+// wraps to the first slot; select opens history and long presses there do nothing.
+static void testHistoryEntry() {
+	host::reset(MONDAY_MORNING);
+	launch([] {
+		CHECK(!drawn("history"));
+		host::click(BUTTON_ID_UP);
+		host::click(BUTTON_ID_DOWN);
+		CHECK(drawn("history"));
+		CHECK_EQ(getTrackingList()->getSelectedIndex(), 5);
+		host::longClick(BUTTON_ID_SELECT);
+		host::longClick(BUTTON_ID_DOWN);
+		CHECK_EQ(getTrackingList()->getMode(), NORMAL_MODE);
+		host::click(BUTTON_ID_DOWN);
+		CHECK_EQ(getTrackingList()->getSelectedIndex(), 0);
+		CHECK(!drawn("history"));
+		host::click(BUTTON_ID_UP);
+		host::click(BUTTON_ID_DOWN);
+		host::click(BUTTON_ID_BACK);
+		CHECK_EQ(getTrackingList()->getSelectedIndex(), NULL_V);
+		CHECK(drawn("8:00"));
+		host::click(BUTTON_ID_UP);
+		host::click(BUTTON_ID_DOWN);
+		host::click(BUTTON_ID_SELECT);
+		CHECK(drawn("today"));
+		CHECK_EQ(getTrackingList()->getActiveIndex(), NULL_V);
+		host::click(BUTTON_ID_BACK);
+		host::click(BUTTON_ID_UP);
+		CHECK(drawn("distractions"));
+		CHECK_EQ(getTrackingList()->getSelectedIndex(), 5);
+	});
+}
+
+// Select on the merge-split header only leaves it, and quick selects never open history.
+static void testLeaveMergeWithoutHistory() {
+	host::reset(MONDAY_MORNING);
+	launch([] {
+		host::click(BUTTON_ID_DOWN);
+		host::click(BUTTON_ID_SELECT);
+		host::click(BUTTON_ID_BACK);
+		host::click(BUTTON_ID_SELECT);
+		host::advance(1);
+		host::click(BUTTON_ID_SELECT);
+		CHECK(!drawn("today"));
+		CHECK(drawn("hard"));
+		host::advance(1);
+		host::click(BUTTON_ID_DOWN);
+		host::click(BUTTON_ID_SELECT);
+		host::click(BUTTON_ID_SELECT);
+		CHECK(!drawn("today"));
+		CHECK_EQ(getTrackingList()->getActiveIndex(), 0);
+	});
+}
+
+struct ExportChunk {
+	int number;
+	vector<uint8_t> data;
+	bool end;
+};
+
+static vector<ExportChunk> exported;
+
+static bool receiveExport(DictionaryIterator* iter) {
+	Tuple* chunk = dict_find(iter, HistoryExport::CHUNK_KEY);
+	Tuple* data = dict_find(iter, HistoryExport::DATA_KEY);
+	if (!chunk)
+		return true;
+	ExportChunk received = { chunk->value->int32, vector<uint8_t>(), dict_find(iter, HistoryExport::END_KEY) != NULL };
+	if (data)
+		received.data.assign(data->value->data, data->value->data + data->length);
+	exported.push_back(received);
+	return true;
+}
+
+// Enough start/stop pairs to fill every history page, so the pages need more than one chunk.
+static void fillHistoryAndOpen() {
+	host::click(BUTTON_ID_DOWN);
+	for (int i = 0; i < 600; ++i) {
+		host::click(BUTTON_ID_SELECT);
+		host::advance(1);
+	}
+	host::click(BUTTON_ID_BACK);
+	openHistoryView();
+	CHECK(drawn("today"));
+}
+
+// Every exported page has to match the saved one byte for byte.
+static void checkExport() {
+	History saved(5000);
+	uint16_t sequence = saved.getNewestSequence() - saved.getPageCount() + 1;
+	int pages = 0;
+	for (size_t i = 1; i < exported.size(); ++i) {
+		vector<uint8_t> const& data = exported[i].data;
+		for (size_t offset = 0; offset < data.size(); offset += 1 + data[offset], ++pages) {
+			uint8_t page[History::PAGE_SIZE];
+			int size = saved.readPage(sequence++, page);
+			CHECK_EQ(size, data[offset]);
+			CHECK(memcmp(page, &data[offset + 1], size) == 0);
+		}
+	}
+	CHECK_EQ(pages, History::PAGES);
+	CHECK(exported.back().end);
+}
+
+static void testHistoryExport() {
+	host::reset(MONDAY_MORNING);
+	exported.clear();
+	host::setPhone(receiveExport);
+	launch([] {
+		fillHistoryAndOpen();
+		host::longClick(BUTTON_ID_SELECT);
+		CHECK_EQ(exported.size(), 3);
+		for (size_t i = 0; i < exported.size(); ++i)
+			CHECK_EQ(exported[i].number, (int)i);
+		CHECK(drawn("today"));
+	});
+	checkExport();
+}
+
+static void testHistoryExportResend() {
+	host::reset(MONDAY_MORNING);
+	exported.clear();
+	static bool rejected;
+	rejected = false;
+	host::setPhone([](DictionaryIterator* iter) {
+		if (!rejected && dict_find(iter, HistoryExport::DATA_KEY)) {
+			rejected = true;
+			return false;
+		}
+		return receiveExport(iter);
+	});
+	launch([] {
+		fillHistoryAndOpen();
+		host::setConnected(false);
+		host::longClick(BUTTON_ID_SELECT);
+		CHECK(exported.empty());
+		host::setConnected(true);
+		CHECK_EQ(exported.size(), 1);
+		host::advance(2);
+		CHECK_EQ(exported.size(), 3);
+		CHECK_EQ(exported[1].number, 1);
+	});
+	checkExport();
+}
+
+// A diagnostics message still in flight keeps the outbox busy; the export waits for it.
+static void testHistoryExportBusyOutbox() {
+	host::reset(MONDAY_MORNING);
+	exported.clear();
+	host::setPhone(receiveExport);
+	launch([] {
+		fillHistoryAndOpen();
+		host::click(BUTTON_ID_SELECT);
+		host::holdOutbox(true);
+		host::longClick(BUTTON_ID_SELECT);
+		host::click(BUTTON_ID_BACK);
+		host::longClick(BUTTON_ID_SELECT);
+		host::holdOutbox(false);
+		CHECK(exported.empty());
+		host::advance(2);
+		CHECK_EQ(exported.size(), 3);
+		CHECK_EQ(exported[0].number, 0);
+	});
+	checkExport();
+}
+
+// Older firmware opens a smaller outbox than asked for, so the pages need more chunks.
+static void testHistoryExportSmallOutbox() {
+	host::reset(MONDAY_MORNING);
+	exported.clear();
+	host::setPhone(receiveExport);
+	host::setOutboxSizeMaximum(400);
+	launch([] {
+		fillHistoryAndOpen();
+		host::longClick(BUTTON_ID_SELECT);
+		CHECK_EQ(exported.size(), 5);
+		for (size_t i = 0; i < exported.size(); ++i)
+			CHECK(exported[i].data.size() <= 400 - HistoryExport::MESSAGE_OVERHEAD);
+	});
+	checkExport();
+}
+
+static void testWakeups() {
+	host::reset(MONDAY_MORNING);
+	launch([] {
+		host::resetStats();
+		host::advance(60 * 60);
+		CHECK_EQ(host::stats().wakeups, 60);
+		host::advance(17);
+		host::click(BUTTON_ID_DOWN);
+		host::click(BUTTON_ID_SELECT);
+		host::advance(5);
+		host::resetStats();
+		host::advance(8 * 60 * 60);
+		CHECK(host::stats().wakeups <= 8 * 2 * 60);
+		CHECK_EQ(host::stats().timers, 8 * 60);
+		CHECK(drawn("8:00"));
+		vector<uint32_t> vibes = host::vibes();
+		CHECK_EQ(vibes.size(), 8);
+		CHECK_EQ(vibes.back(), 3);
+	});
+}
+
+// The active slot turns a minute between two ticks and is shown at once.
+static void testActiveMinuteRollover() {
+	host::reset(MONDAY_MORNING);
+	launch([] {
+		host::advance(17);
+		host::click(BUTTON_ID_DOWN);
+		host::click(BUTTON_ID_SELECT);
+		host::advance(59);
+		CHECK(drawn("0:00"));
+		host::advance(1);
+		CHECK(drawn("0:01"));
+		CHECK(drawn("8:01"));
+	});
+}
+
+static void testPartialRedraw() {
+	host::reset(MONDAY_MORNING);
+	launch([] {
+		host::click(BUTTON_ID_DOWN);
+		host::click(BUTTON_ID_SELECT);
+		host::resetStats();
+		host::advance(10 * 60);
+		CHECK(drawn("0:10"));
+		CHECK(drawn("8:10"));
+		CHECK_EQ(host::stats().reloads, 0);
+		CHECK(host::stats().renders >= 10);
+		host::click(BUTTON_ID_BACK);
+		host::click(BUTTON_ID_SELECT);
+		CHECK_EQ(host::stats().reloads, 0);
+		host::longClick(BUTTON_ID_UP);
+		CHECK_EQ(host::stats().reloads, 1);
+		CHECK(drawn("0:10"));
+		CHECK_EQ(host::frame().size(), 2 + 2 * 2);
+	});
+}
+
+static void testDiagnostics() {
+	host::reset(MONDAY_MORNING);
+	static uint32_t sentTicks;
+	sentTicks = 0;
+	host::setPhone([](DictionaryIterator* iter) {
+		Tuple* ticks = dict_find(iter, Diagnostics::FIRST_KEY);
+		if (ticks)
+			sentTicks = ticks->value->uint32;
+		return true;
+	});
+	launch([] {
+		host::click(BUTTON_ID_DOWN);
+		host::click(BUTTON_ID_SELECT);
+		host::advance(10 * 60);
+		CHECK_EQ(diagnostics.ticks, 10);
+		CHECK(diagnostics.partialRedraws >= 10);
+		CHECK_EQ(diagnostics.reloads, 1);
+		CHECK(diagnostics.draws > 0);
+		CHECK(heapBytesInUse > 0);
+		CHECK(heapBytesPeak >= heapBytesInUse);
+		CHECK(persistBytesWritten > 0);
+		CHECK(diagnostics.timers >= 2);
+		CHECK_EQ(diagnostics.timers, host::stats().timers);
+		host::click(BUTTON_ID_BACK);
+		openHistoryView();
+		uint32_t draws = diagnostics.draws;
+		host::click(BUTTON_ID_UP);
+		host::click(BUTTON_ID_UP);
+		CHECK(diagnostics.draws >= draws + 2 * 7);
+		host::click(BUTTON_ID_SELECT);
+		CHECK(drawn("ticks"));
+		CHECK(drawn("10"));
+		host::longClick(BUTTON_ID_SELECT);
+		CHECK_EQ(sentTicks, 10);
+		CHECK_EQ(diagnostics.messageBytesOut, 1 + Diagnostics::COUNTERS * (7 + 4));
+		host::click(BUTTON_ID_BACK);
+		CHECK(drawn("today"));
+	});
+}
+
+static void testFreezeExpiry() {
+	host::reset(MONDAY_MORNING);
+	launch([] {
+		host::click(BUTTON_ID_DOWN);
+		host::longClick(BUTTON_ID_SELECT);
+		CHECK(drawn("0:00/0:00"));
+		host::advance(30);
+		host::click(BUTTON_ID_UP);
+		CHECK(drawn("1:00/1:00"));
+		host::advance(59);
+		CHECK(drawn("1:00/1:00"));
+		host::advance(1);
+		CHECK(!drawn("1:00/1:00"));
+		CHECK(drawn("1:00"));
+	});
+}
+
+static void testSoftResetAndRestore() {
+	host::reset(MONDAY_MORNING);
+	launch([] {
+		host::click(BUTTON_ID_DOWN);
+		host::click(BUTTON_ID_SELECT);
+		host::advance(2 * 60 * 60);
+		host::click(BUTTON_ID_BACK);
+		host::longClick(BUTTON_ID_SELECT);
+		CHECK(drawn("0:00/2:00"));
+		host::longClick(BUTTON_ID_SELECT);
+		CHECK(drawn("2:00"));
+		CHECK(!drawn("0:00/2:00"));
+	});
+}
+
+// Undo and redo keep their steps in RAM; only the save a few seconds later writes.
+static void testUndoWithoutFlash() {
+	host::reset(MONDAY_MORNING);
+	launch([] {
+		host::click(BUTTON_ID_DOWN);
+		host::click(BUTTON_ID_SELECT);
+		host::advance(2 * 60 * 60);
+		host::click(BUTTON_ID_BACK);
+		host::resetStats();
+		host::longClick(BUTTON_ID_SELECT);
+		CHECK(drawn("0:00/2:00"));
+		host::longClick(BUTTON_ID_SELECT);
+		CHECK(drawn("2:00"));
+		CHECK(!drawn("0:00/2:00"));
+		host::click(BUTTON_ID_SELECT);
+		host::longClick(BUTTON_ID_UP);
+		host::click(BUTTON_ID_SELECT);
+		CHECK(drawn("main"));
+		CHECK(!drawn("hard"));
+		openHistoryView();
+		uint32_t reloads = diagnostics.reloads;
+		host::longClick(BUTTON_ID_UP);
+		CHECK(drawn("hard"));
+		CHECK(!drawn("main"));
+		// The split reloads the list and the history view.
+		CHECK_EQ(diagnostics.reloads, reloads + 2);
+		host::longClick(BUTTON_ID_DOWN);
+		CHECK(drawn("main"));
+		CHECK_EQ(host::stats().persistWrites, 0);
+		host::click(BUTTON_ID_BACK);
+		CHECK(drawn("2:00"));
+	});
+}
+
+static void testMergeAndSplit() {
+	host::reset(MONDAY_MORNING);
+	launch([] {
+		host::click(BUTTON_ID_SELECT);
+		host::longClick(BUTTON_ID_UP);
+		CHECK(drawn("main"));
+		CHECK(drawn("secondary"));
+		CHECK_EQ(host::frame().size(), 2 + 2 * 2);
+		host::longClick(BUTTON_ID_DOWN);
+		CHECK(drawn("hard"));
+		CHECK_EQ(host::frame().size(), 2 + 2 * 6);
+	});
+}
+
+// What the config page encodes for desk = (reading, writing) and calls, 6 and 30 hours.
+static const uint8_t CONFIG[] = {
+	1, 3, 1, 6, 30, 0,
+	1, 'r', 'e', 'a', 'd', 'i', 'n', 'g', 0,
+	1, 'w', 'r', 'i', 't', 'i', 'n', 'g', 0,
+	2, 'c', 'a', 'l', 'l', 's', 0,
+	0, 1, 'd', 'e', 's', 'k', 0,
+	203, 32
+};
+
+static AppMessageResult sendConfigChunk(uint8_t const* config, int size, int offset, int length) {
+	uint8_t buffer[ConfigReceiver::INBOX_SIZE];
+	DictionaryIterator iter;
+	dict_write_begin(&iter, buffer, sizeof(buffer));
+	dict_write_int32(&iter, ConfigReceiver::SIZE_KEY, size);
+	dict_write_int32(&iter, ConfigReceiver::OFFSET_KEY, offset);
+	dict_write_data(&iter, ConfigReceiver::DATA_KEY, config + offset, length);
+	return host::sendToWatch(buffer, dict_write_end(&iter));
+}
+
+static AppMessageResult sendConfigChunk(int offset, int length) {
+	return sendConfigChunk(CONFIG, sizeof(CONFIG), offset, length);
+}
+
+static void testConfigMessage() {
+	host::reset(MONDAY_MORNING);
+	launch([] {
+		CHECK_EQ(sendConfigChunk(0, 16), APP_MSG_OK);
+		CHECK_EQ(sendConfigChunk(16, 16), APP_MSG_OK);
+		CHECK_EQ(sendConfigChunk(16, 16), APP_MSG_OK);
+		CHECK(!drawn("desk"));
+		CHECK_EQ(sendConfigChunk(32, sizeof(CONFIG) - 32), APP_MSG_OK);
+		CHECK(drawn("reading"));
+		CHECK(drawn("calls"));
+		CHECK_EQ(host::frame().size(), 2 + 2 * 3);
+		CHECK(!host::persistHas(0));
+		CHECK(!host::persistHas(1000));
+	});
+	launch([] {
+		CHECK(drawn("writing"));
+		CHECK_EQ(host::frame().size(), 2 + 2 * 3);
+		host::click(BUTTON_ID_SELECT);
+		host::longClick(BUTTON_ID_UP);
+		CHECK(drawn("desk"));
+		CHECK(drawn("calls"));
+	});
+}
+
+// A chunk past the received bytes is dropped, a restarted blob replaces the partial one and a
+// blob with a bad checksum changes nothing.
+static void testConfigMessageOutOfOrder() {
+	host::reset(MONDAY_MORNING);
+	launch([] {
+		CHECK_EQ(sendConfigChunk(0, 16), APP_MSG_OK);
+		CHECK_EQ(sendConfigChunk(32, sizeof(CONFIG) - 32), APP_MSG_OK);
+		CHECK(drawn("hard"));
+		CHECK_EQ(sendConfigChunk(0, 32), APP_MSG_OK);
+		CHECK_EQ(sendConfigChunk(32, sizeof(CONFIG) - 33), APP_MSG_OK);
+		CHECK(drawn("hard"));
+		uint8_t corrupt[sizeof(CONFIG)];
+		memcpy(corrupt, CONFIG, sizeof(CONFIG));
+		corrupt[10] ^= 1;
+		CHECK_EQ(sendConfigChunk(corrupt, sizeof(corrupt), 0, sizeof(corrupt)), APP_MSG_OK);
+		CHECK(drawn("hard"));
+		CHECK_EQ(host::frame().size(), 2 + 2 * 6);
+	});
+}
+
+// A negative offset, an empty chunk and a string in place of the bytes are all dropped, and the
+// blob carries on from where it was.
+static void testConfigMessageMalformed() {
+	host::reset(MONDAY_MORNING);
+	launch([] {
+		CHECK_EQ(sendConfigChunk(0, 16), APP_MSG_OK);
+		uint8_t junk[16];
+		memset(junk, 0xFF, sizeof(junk));
+		uint8_t buffer[ConfigReceiver::INBOX_SIZE];
+		DictionaryIterator iter;
+		dict_write_begin(&iter, buffer, sizeof(buffer));
+		dict_write_int32(&iter, ConfigReceiver::SIZE_KEY, sizeof(CONFIG));
+		dict_write_int32(&iter, ConfigReceiver::OFFSET_KEY, -16);
+		dict_write_data(&iter, ConfigReceiver::DATA_KEY, junk, sizeof(junk));
+		CHECK_EQ(host::sendToWatch(buffer, dict_write_end(&iter)), APP_MSG_OK);
+		dict_write_begin(&iter, buffer, sizeof(buffer));
+		dict_write_int32(&iter, ConfigReceiver::SIZE_KEY, sizeof(CONFIG));
+		dict_write_int32(&iter, ConfigReceiver::OFFSET_KEY, 16);
+		dict_write_cstring(&iter, ConfigReceiver::DATA_KEY, "junk");
+		CHECK_EQ(host::sendToWatch(buffer, dict_write_end(&iter)), APP_MSG_OK);
+		CHECK_EQ(sendConfigChunk(16, 0), APP_MSG_OK);
+		CHECK_EQ(sendConfigChunk(16, sizeof(CONFIG) - 16), APP_MSG_OK);
+		CHECK(drawn("reading"));
+		CHECK_EQ(host::frame().size(), 2 + 2 * 3);
+	});
+}
+
+// The same with a 10 minute goal on reading.
+static const uint8_t GOAL_CONFIG[] = {
+	2, 3, 1, 6, 30, 0,
+	1, 'r', 'e', 'a', 'd', 'i', 'n', 'g', 0,
+	1, 'w', 'r', 'i', 't', 'i', 'n', 'g', 0,
+	2, 'c', 'a', 'l', 'l', 's', 0,
+	0, 1, 'd', 'e', 's', 'k', 0,
+	1, 0, ALARM_GOAL, 10, 0,
+	216, 98
+};
+
+// The goal vibrates once as reading reaches it, and survives a relaunch for the next day.
+static void testGoalConfig() {
+	host::reset(MONDAY_MORNING);
+	launch([] {
+		for (int offset = 0; offset < (int)sizeof(GOAL_CONFIG); offset += ConfigReceiver::CHUNK_SIZE)
+			sendConfigChunk(GOAL_CONFIG, sizeof(GOAL_CONFIG), offset, std::min((int)sizeof(GOAL_CONFIG) - offset, (int)ConfigReceiver::CHUNK_SIZE));
+		CHECK(drawn("reading"));
+		host::click(BUTTON_ID_DOWN);
+		host::click(BUTTON_ID_SELECT);
+		host::click(BUTTON_ID_BACK);
+		host::resetStats();
+		host::advance(10 * 60);
+		CHECK_EQ(host::vibes().size(), 1);
+		CHECK_EQ(host::vibes().back(), 5);
+		host::advance(50 * 60);
+		CHECK_EQ(host::vibes().size(), 2);
+		CHECK_EQ(host::vibes().back(), 1);
+		host::longClick(BUTTON_ID_SELECT);
+	});
+	launch([] {
+		host::advance(10 * 60);
+		CHECK_EQ(host::vibes().size(), 3);
+		CHECK_EQ(host::vibes().back(), 5);
+	});
+}
+
+static void sendConfig(TrackingList& list) {
+	schar config[PERSIST_DATA_MAX_LENGTH];
+	int size = list.serializeConfig(config, sizeof(config));
+	for (int offset = 0; offset < size; offset += ConfigReceiver::CHUNK_SIZE)
+		sendConfigChunk((uint8_t const*)config, size, offset, std::min(size - offset, (int)ConfigReceiver::CHUNK_SIZE));
+}
+
+// Keeps hard and simple under work, drops the rest and adds calls.
+static void sendChangedConfig() {
+	PairMap pairs;
+	TrackingList list(3, pairs);
+	list.addElement("hard", 0);
+	list.addElement("simple", 0);
+	list.addElement("calls", 1);
+	list.addPair(0, 1, "work");
+	sendConfig(list);
+}
+
+static void testConfigKeepsTime() {
+	host::reset(MONDAY_MORNING);
+	launch([] {
+		host::click(BUTTON_ID_DOWN);
+		host::click(BUTTON_ID_SELECT);
+		host::advance(60 * 60);
+		host::resetStats();
+		sendChangedConfig();
+		CHECK_EQ(host::stats().persistWrites, 2);
+		CHECK(drawn("hard"));
+		CHECK(drawn("calls"));
+		CHECK(!drawn("education"));
+		CHECK_EQ(host::frame().size(), 2 + 2 * 3);
+		host::advance(30 * 60);
+		CHECK(drawn("1:30"));
+	});
+	launch([] {
+		CHECK(drawn("calls"));
+		CHECK(drawn("1:30"));
+		host::advance(30 * 60);
+		CHECK(drawn("2:00"));
+	});
+}
+
+// A config arriving while the history view is open replaces its rows. Slots moved, so the log
+// starts over and only the time since counts.
+static void testConfigWhileHistoryOpen() {
+	host::reset(MONDAY_MORNING);
+	launch([] {
+		host::click(BUTTON_ID_DOWN);
+		host::click(BUTTON_ID_SELECT);
+		host::advance(60 * 60);
+		host::click(BUTTON_ID_BACK);
+		openHistoryView();
+		CHECK(drawn("today"));
+		sendChangedConfig();
+		CHECK(drawn("today"));
+		CHECK(drawn("calls"));
+		CHECK(!drawn("education"));
+		CHECK(!drawn("1:00"));
+		host::advance(60);
+		CHECK(drawn("0:01"));
+	});
+}
+
+// Past a screenful of slots rows are one leaf high and only the ones in view are drawn.
+static void testManySlots() {
+	host::reset(MONDAY_MORNING);
+	launch([] {
+		PairMap pairs;
+		TrackingList list(24, pairs);
+		char name[4];
+		for (int i = 0; i < 24; ++i) {
+			snprintf(name, sizeof(name), "s%d", i + 1);
+			list.addElement(name, 0);
+		}
+		list.addPair(22, 23, "last");
+		sendConfig(list);
+		CHECK(drawn("s1"));
+		CHECK(drawn("s6"));
+		CHECK(!drawn("s7"));
+		CHECK_EQ(host::frame().size(), 2 + 2 * 6);
+		for (int i = 0; i < 24; ++i)
+			host::click(BUTTON_ID_DOWN);
+		host::click(BUTTON_ID_SELECT);
+		CHECK(drawn("s24"));
+		CHECK(!drawn("s1"));
+		host::resetStats();
+		host::advance(60 * 60);
+		CHECK(drawn("1:00"));
+		CHECK(host::stats().rowDraws <= 7 * host::stats().renders);
+		host::click(BUTTON_ID_BACK);
+		host::click(BUTTON_ID_SELECT);
+		host::longClick(BUTTON_ID_UP);
+		CHECK(drawn("s1"));
+		CHECK_EQ(host::frame().size(), 2 + 2 * 6);
+		host::click(BUTTON_ID_UP);
+		CHECK(drawn("last"));
+		CHECK(drawn("1:00"));
+		CHECK(!drawn("s23"));
+		CHECK(!drawn("s16"));
+		CHECK(!drawn("history"));
+	});
+	// The whole state fits the journal, so it survives a restart.
+	launch([] {
+		CHECK_EQ(getTrackingList()->size(), 23);
+		CHECK(strcmp(getTrackingList()->getName(22), "last") == 0);
+		CHECK(drawn("1:00"));
+	});
+}
+
+int main() {
+	RUN(testFirstLaunch);
+	RUN(testTrackingAndRestore);
+	RUN(testPowerLoss);
+	RUN(testLegacyState);
+	RUN(testStaleLegacyState);
+	RUN(testGlanceWritesNothing);
+	RUN(testHeaderBeforeModel);
+	RUN(testLegacyConfig);
+	RUN(testLegacyConfigTooManyLeaves);
+	RUN(testHistory);
+	RUN(testHistoryView);
+	RUN(testHistoryEntry);
+	RUN(testLeaveMergeWithoutHistory);
+	RUN(testHistoryExport);
+	RUN(testHistoryExportResend);
+	RUN(testHistoryExportBusyOutbox);
+	RUN(testHistoryExportSmallOutbox);
+	RUN(testWakeups);
+	RUN(testActiveMinuteRollover);
+	RUN(testPartialRedraw);
+	RUN(testDiagnostics);
+	RUN(testFreezeExpiry);
+	RUN(testSoftResetAndRestore);
+	RUN(testUndoWithoutFlash);
+	RUN(testMergeAndSplit);
+	RUN(testConfigMessage);
+	RUN(testConfigMessageOutOfOrder);
+	RUN(testConfigMessageMalformed);
+	RUN(testConfigKeepsTime);
+	RUN(testConfigWhileHistoryOpen);
+	RUN(testGoalConfig);
+	RUN(testManySlots);
+	return failures != 0;
+}
@@ -0,0 +1,783 @@
+#include "tracker_data.hpp"
+#include "journal.hpp"
+#include "host.hpp"
+#include "test.hpp"
+
+#include <vector>
+
+using namespace std;
+
+static const int HEADER_TIME_OFFSET = 4;
+
+static TrackingList* createList() {
+	PairMap pairs;
+	pairs.insert("hardsimple", "work");
+	pairs.insert("overviewoptimization", "additional");
+	pairs.insert("workeducation", "main");
+	pairs.insert("additionaldistractions", "secondary");
+	TrackingList* list = new TrackingList(6, pairs);
+	list->addElement("hard", 0);
+	list->addElement("simple", 0);
+	list->addElement("education", 1);
+	list->addElement("overview", 2);
+	list->addElement("optimization", 2);
+	list->addElement("distractions", 3);
+	return list;
+}
+
+static void setTime(TrackingList* list, int index, int seconds) {
+	list->resetIndex();
+	list->incIndex(index + 1);
+	list->resetSelectedTime();
+	list->addTime(seconds);
+}
+
+static void testBuildAndBreak() {
+	TrackingList* list = createList();
+	CHECK(list->buildPair(0, 1));
+	CHECK_EQ(list->size(), 5);
+	CHECK(strcmp(list->getName(0), "work") == 0);
+	CHECK_EQ(list->at(0)->getHeight(), 2);
+	CHECK(list->buildPair(0, 1));
+	CHECK(strcmp(list->getName(0), "main") == 0);
+	CHECK_EQ(list->at(0)->getHeight(), 3);
+	CHECK_EQ(list->at(0)->getPriority(), 0);
+	CHECK(!list->buildPair(1, 3));
+	CHECK(list->buildAll());
+	CHECK_EQ(list->size(), 2);
+	CHECK(strcmp(list->getName(1), "secondary") == 0);
+	CHECK_EQ(list->at(1)->getPriority(), 2);
+	CHECK_EQ(list->totalHeight(), 6);
+	CHECK(!list->buildPair(0, 1));
+
+	CHECK(list->breakPair(1));
+	CHECK_EQ(list->size(), 3);
+	CHECK(!list->breakPair(2));
+	CHECK(list->breakAll());
+	CHECK_EQ(list->size(), 6);
+	char const* names[] = { "hard", "simple", "education", "overview", "optimization", "distractions" };
+	for (int i = 0; i < 6; ++i)
+		CHECK(strcmp(list->getName(i), names[i]) == 0);
+	delete list;
+}
+
+static void testBreakDistribution() {
+	TrackingList* list = createList();
+	list->buildPair(0, 1);
+	setTime(list, 0, 61);
+	list->breakPair(0);
+	CHECK_EQ(list->at(0)->getTime(), 31);
+	CHECK_EQ(list->at(1)->getTime(), 30);
+
+	setTime(list, 0, 100);
+	setTime(list, 1, 0);
+	list->buildPair(0, 1);
+	setTime(list, 0, 160);
+	list->breakPair(0);
+	CHECK_EQ(list->at(0)->getTime(), 100);
+	CHECK_EQ(list->at(1)->getTime(), 60);
+
+	list->buildPair(0, 1);
+	setTime(list, 0, 310);
+	list->breakPair(0);
+	CHECK_EQ(list->at(0)->getTime(), 155);
+	CHECK_EQ(list->at(1)->getTime(), 155);
+
+	setTime(list, 0, 0);
+	setTime(list, 1, 0);
+	setTime(list, 2, 0);
+	list->buildPair(0, 1);
+	list->buildPair(0, 1);
+	setTime(list, 0, 120);
+	list->breakPair(0);
+	CHECK_EQ(list->at(0)->getTime(), 120);
+	CHECK_EQ(list->at(1)->getTime(), 0);
+
+	setTime(list, 1, 50);
+	setTime(list, 0, 10);
+	list->buildPair(0, 1);
+	setTime(list, 0, 20);
+	list->breakPair(0);
+	CHECK_EQ(list->at(0)->getTime(), 10);
+	CHECK_EQ(list->at(1)->getTime(), 10);
+	delete list;
+}
+
+static void testTimeAccrual() {
+	host::reset(1000);
+	TrackingList* list = createList();
+	list->updateTime();
+	list->incIndex(3);
+	list->switchIndex();
+	CHECK_EQ(list->getActiveIndex(), 2);
+	host::advance(90);
+	CHECK_EQ(list->updateTime(), 90);
+	CHECK_EQ(list->at(2)->getTime(), 90);
+
+	list->switchMode(FREEZE_MODE);
+	host::advance(30);
+	CHECK_EQ(list->updateTime(), NULL_V);
+	list->switchMode(NORMAL_MODE);
+	host::advance(30);
+	CHECK_EQ(list->updateTime(), 120);
+	CHECK_EQ(list->totalTime(false), 120);
+
+	list->resetTime(false);
+	CHECK_EQ(list->totalTime(false), 0);
+	CHECK_EQ(list->totalTime(), 120);
+	list->resetTime(true);
+	CHECK_EQ(list->totalTime(), 0);
+	delete list;
+}
+
+static void testSerialize() {
+	host::reset(1000);
+	TrackingList* list = createList();
+	for (int i = 0; i < 6; ++i)
+		setTime(list, i, 60 * (i + 1));
+	list->buildPair(0, 1);
+	list->buildPair(2, 3);
+	list->buildPair(0, 1);
+	int mainTime = list->at(0)->getTime();
+	int additionalTime = list->at(1)->getTime();
+	list->resetIndex();
+	list->incIndex(2);
+	list->switchIndex();
+
+	schar buffer[PERSIST_DATA_MAX_LENGTH];
+	int size = list->serialize(buffer, sizeof(buffer));
+	CHECK_EQ(size, list->getBinarySize());
+	CHECK_EQ(list->serialize(buffer, size - 1), 0);
+	CHECK_EQ(list->size(), 3);
+	CHECK_EQ(list->getUsedNodes(), 9);
+	TrackingList* restored = createList();
+	CHECK(restored->deserialize(buffer, size));
+
+	CHECK_EQ(restored->size(), 3);
+	CHECK(strcmp(restored->getName(0), "main") == 0);
+	CHECK(strcmp(restored->getName(1), "additional") == 0);
+	CHECK(strcmp(restored->getName(2), "distractions") == 0);
+	CHECK_EQ(restored->at(0)->getTime(), mainTime);
+	CHECK_EQ(restored->at(1)->getTime(), additionalTime);
+	CHECK_EQ(restored->getActiveIndex(), 1);
+	CHECK_EQ(restored->totalTime(), 60 * 21);
+	CHECK(restored->totalsConsistent());
+	delete restored;
+	delete list;
+}
+
+static void testSerializeKeepsPairTime() {
+	host::reset(1000);
+	TrackingList* list = createList();
+	setTime(list, 0, 100);
+	list->buildPair(0, 1);
+	setTime(list, 0, 160);
+	schar buffer[PERSIST_DATA_MAX_LENGTH];
+	int size = list->serialize(buffer, sizeof(buffer));
+
+	TrackingList* restored = createList();
+	CHECK(restored->deserialize(buffer, size));
+	CHECK_EQ(restored->at(0)->getTime(), 160);
+	restored->breakPair(0);
+	list->breakPair(0);
+	CHECK_EQ(restored->at(0)->getTime(), list->at(0)->getTime());
+	CHECK_EQ(restored->at(1)->getTime(), list->at(1)->getTime());
+	delete restored;
+	delete list;
+}
+
+static void testDeserializeRejects() {
+	host::reset(1000);
+	TrackingList* list = createList();
+	setTime(list, 2, 60);
+	list->buildAll();
+	schar buffer[PERSIST_DATA_MAX_LENGTH];
+	int size = list->serialize(buffer, sizeof(buffer));
+
+	TrackingList* restored = createList();
+	CHECK(!restored->deserialize(buffer, size - 1));
+	buffer[HEADER_TIME_OFFSET] ^= 1;
+	CHECK(!restored->deserialize(buffer, size));
+	buffer[HEADER_TIME_OFFSET] ^= 1;
+	buffer[0] = 0;
+	CHECK(!restored->deserialize(buffer, size));
+	CHECK_EQ(restored->size(), 6);
+	CHECK_EQ(restored->totalTime(), 0);
+	delete restored;
+
+	PairMap pairs;
+	restored = new TrackingList(6, pairs);
+	for (int i = 0; i < 6; ++i)
+		restored->addElement(list->getName(0), 0);
+	list->serialize(buffer, sizeof(buffer));
+	CHECK(!restored->deserialize(buffer, size));
+	CHECK_EQ(restored->size(), 6);
+	CHECK(restored->totalsConsistent());
+	delete restored;
+	delete list;
+}
+
+// The first versions' layout: an 11 byte header and every leaf's time closed by ',' or by ')' for
+// a pair with the row before. Here work and then main are built, nothing is active and the
+// accumulated time is 100.
+static void testDeserializeLegacy() {
+	host::reset(1000);
+	schar legacy[] = {
+		0, NULL_V, NULL_V, (schar)0xe8, 3, 0, 0, 100, 0, 0, 0,
+		10, 0, 0, 0, ',',
+		20, 0, 0, 0, ')',
+		30, 0, 0, 0, ')',
+		40, 0, 0, 0, ',',
+		50, 0, 0, 0, ',',
+		60, 0, 0, 0, ','
+	};
+	TrackingList* list = createList();
+	CHECK(!list->deserializeLegacy(legacy, sizeof(legacy) - 5));
+	CHECK(!list->deserializeLegacy(legacy, sizeof(legacy) - 1));
+	CHECK(list->deserializeLegacy(legacy, sizeof(legacy)));
+	CHECK_EQ(list->size(), 4);
+	CHECK(strcmp(list->getName(0), "main") == 0);
+	CHECK_EQ(list->at(0)->getTime(), 60);
+	CHECK_EQ(list->totalTime(false), 210);
+	CHECK_EQ(list->totalTime(), 310);
+	CHECK_EQ(list->getActiveIndex(), NULL_V);
+	CHECK(list->totalsConsistent());
+
+	// A pair the config does not have stays split.
+	legacy[11 + 5 * 5 + 4] = ')';
+	CHECK(list->deserializeLegacy(legacy, sizeof(legacy)));
+	CHECK_EQ(list->size(), 4);
+	CHECK_EQ(list->at(3)->getTime(), 60);
+	delete list;
+}
+
+static void testRunningTotals() {
+	host::reset(1000);
+	srand(42);
+	TrackingList* list = createList();
+	list->updateTime();
+	for (int step = 0; step < 5000; ++step) {
+		int index = rand() % list->size();
+		switch (rand() % 9) {
+			case 0:
+				list->resetIndex();
+				list->incIndex(index + 1);
+				list->switchIndex();
+				break;
+			case 1:
+				list->resetIndex();
+				list->incIndex(index + 1);
+				list->addTime(rand() % 7200 - 3600);
+				break;
+			case 2:
+				if (index < list->size() - 1)
+					list->buildPair(index, index + 1);
+				break;
+			case 3:
+				list->breakPair(index);
+				break;
+			case 4:
+				list->resetIndex();
+				list->incIndex(index + 1);
+				list->resetSelectedTime();
+				break;
+			case 5:
+				if (rand() % 10 == 0)
+					list->resetTime(rand() % 2);
+				break;
+			case 6:
+				list->switchMode(rand() % 4 == 0 ? FREEZE_MODE : NORMAL_MODE);
+				break;
+			default:
+				host::advance(rand() % 600);
+				list->updateTime();
+				break;
+		}
+		CHECK(list->totalsConsistent());
+		CHECK(list->totalTime() >= list->totalTime(false));
+	}
+	list->breakAll();
+	CHECK(list->totalsConsistent());
+	delete list;
+}
+
+static void testNodeBlock() {
+	TrackingList* list = createList();
+	CHECK_EQ(list->getNodeCapacity(), 11);
+	CHECK_EQ(list->getUsedNodes(), 6);
+	for (int i = 0; i < 100; ++i) {
+		list->buildAll();
+		CHECK_EQ(list->getUsedNodes(), 10);
+		CHECK_EQ(list->totalHeight(), 6);
+		CHECK_EQ(list->at(0)->getHeight(), 3);
+		list->breakAll();
+		CHECK_EQ(list->getUsedNodes(), 6);
+	}
+	CHECK_EQ(list->getNodeHighWater(), 10);
+	list->addElement("extra", 0);
+	CHECK_EQ(list->size(), 6);
+	delete list;
+}
+
+// A chain of pairs over the most leaves takes one pair per leaf but the first.
+static void testFullPairTable() {
+	PairMap pairs;
+	char key[16], name[8];
+	for (int i = 1; i < TrackingList::MAX_LEAVES; ++i) {
+		snprintf(key, sizeof(key), i == 1 ? "l0l1" : "p%dl%d", i - 1, i);
+		snprintf(name, sizeof(name), "p%d", i);
+		pairs.insert(key, name);
+	}
+	TrackingList* list = new TrackingList(TrackingList::MAX_LEAVES, pairs);
+	for (int i = 0; i < TrackingList::MAX_LEAVES; ++i) {
+		snprintf(name, sizeof(name), "l%d", i);
+		list->addElement(name, 0);
+	}
+	CHECK(list->buildAll());
+	CHECK_EQ(list->size(), 1);
+	CHECK(strcmp(list->getName(0), "p63") == 0);
+	delete list;
+}
+
+static void testLongNames() {
+	PairMap pairs;
+	pairs.insert("communication" "documentation", "paperwork");
+	pairs.insert("paperworkhard", "office");
+	TrackingList* list = new TrackingList(3, pairs);
+	list->addElement("communication", 0);
+	list->addElement("documentation", 0);
+	list->addElement("hard", 0);
+	CHECK(list->buildPair(0, 1));
+	CHECK(strcmp(list->getName(0), "paperwork") == 0);
+	CHECK(list->buildPair(0, 1));
+	CHECK(strcmp(list->getName(0), "office") == 0);
+	CHECK(list->breakAll());
+	CHECK(!list->buildPair(1, 2));
+	delete list;
+}
+
+static void testPairTable() {
+	PairMap pairs;
+	pairs.insert("workeducation", "main");
+	pairs.insert("hardsimple", "work");
+	pairs.insert("educationhard", "unused");
+	TrackingList* list = new TrackingList(3, pairs);
+	list->addElement("hard", 0);
+	list->addElement("simple", 1);
+	list->addElement("education", 2);
+	CHECK(!list->buildPair(1, 2));
+	CHECK(list->buildAll());
+	CHECK_EQ(list->size(), 1);
+	CHECK(strcmp(list->getName(0), "main") == 0);
+	CHECK_EQ(list->at(0)->getPriority(), 0);
+	CHECK_EQ(list->getUsedNodes(), 5);
+	CHECK(list->breakPair(0));
+	CHECK(strcmp(list->getName(0), "work") == 0);
+	CHECK(list->buildPair(0, 1));
+	CHECK(strcmp(list->getName(0), "main") == 0);
+	delete list;
+}
+
+static void testConfig() {
+	TrackingList* list = createList();
+	schar buffer[PERSIST_DATA_MAX_LENGTH];
+	CHECK(list->serializeConfig(buffer, sizeof(buffer)) > 0);
+	list->addGoal(0, 90, 1);
+	list->addGoal(6, 600, 2);
+	list->addGoal(5, 0, 1);
+	list->addGoal(40, 10, 1);
+	CHECK_EQ(list->getGoals().size(), 2);
+	int size = list->serializeConfig(buffer, sizeof(buffer));
+	CHECK(size > 0);
+	CHECK_EQ(list->serializeConfig(buffer, size - 1), 0);
+	TrackingList* loaded = TrackingList::fromConfig(buffer, size);
+	CHECK(loaded != NULL);
+	CHECK_EQ(loaded->size(), list->size());
+	CHECK_EQ(loaded->getTotalHours(), list->getTotalHours());
+	CHECK_EQ(loaded->getTotalAccHours(), list->getTotalAccHours());
+	CHECK(loaded->buildAll());
+	CHECK(list->buildAll());
+	CHECK_EQ(loaded->size(), list->size());
+	CHECK(strcmp(loaded->getName(0), list->getName(0)) == 0);
+	CHECK_EQ(loaded->at(0)->getPriority(), list->at(0)->getPriority());
+	CHECK_EQ(loaded->getGoals().size(), 2);
+	CHECK_EQ(loaded->getGoals()[1].node, 6);
+	CHECK_EQ(loaded->getGoals()[1].pattern, 2);
+	CHECK_EQ(loaded->getGoals()[1].minutes, 600);
+
+	schar copy[PERSIST_DATA_MAX_LENGTH];
+	CHECK_EQ(loaded->serializeConfig(copy, sizeof(copy)), size);
+	CHECK(memcmp(copy, buffer, size) == 0);
+	buffer[size / 2] ^= 1;
+	CHECK(TrackingList::fromConfig(buffer, size) == NULL);
+	CHECK(TrackingList::fromConfig(buffer, 3) == NULL);
+	delete loaded;
+	delete list;
+}
+
+// A version 1 config of one-letter leaves and pairs of the first two slots, checksummed like the
+// phone does.
+static int writeConfig(schar* s, int leaves, int pairs) {
+	int length = 0;
+	s[length++] = 1;
+	s[length++] = leaves;
+	s[length++] = pairs;
+	s[length++] = 8;
+	s[length++] = 40;
+	s[length++] = 0;
+	for (int i = 0; i < leaves; ++i) {
+		s[length++] = 0;
+		s[length++] = '0' + i;
+		s[length++] = 0;
+	}
+	for (int i = 0; i < pairs; ++i) {
+		s[length++] = 0;
+		s[length++] = 1;
+		s[length++] = 'p';
+		s[length++] = 0;
+	}
+	int sum1 = 0, sum2 = 0;
+	for (int i = 0; i < length; ++i) {
+		sum1 = (sum1 + (uint8_t)s[i]) % 255;
+		sum2 = (sum2 + sum1) % 255;
+	}
+	s[length++] = sum1;
+	s[length++] = sum2;
+	return length;
+}
+
+// More leaves than a NodeIndex can address, or as many pairs as leaves, reject the config.
+static void testConfigLimits() {
+	schar buffer[512];
+	TrackingList* list = TrackingList::fromConfig(buffer, writeConfig(buffer, TrackingList::MAX_NODES - 1, 1));
+	CHECK(list != NULL);
+	if (list) {
+		CHECK_EQ(list->size(), TrackingList::MAX_NODES - 1);
+		// The largest accepted state still fits one journal image.
+		CHECK(list->serialize(buffer, sizeof(buffer)) <= Journal::MAX_IMAGE_SIZE);
+	}
+	delete list;
+	CHECK(TrackingList::fromConfig(buffer, writeConfig(buffer, TrackingList::MAX_NODES, 1)) == NULL);
+	CHECK(TrackingList::fromConfig(buffer, writeConfig(buffer, TrackingList::MAX_LEAVES + 1, 0)) == NULL);
+	CHECK(TrackingList::fromConfig(buffer, writeConfig(buffer, 2, 2)) == NULL);
+	CHECK(TrackingList::fromConfig(buffer, writeConfig(buffer, 0, 0)) == NULL);
+	list = TrackingList::fromConfig(buffer, writeConfig(buffer, 2, 1));
+	CHECK(list != NULL);
+	delete list;
+}
+
+static void testCarryOver() {
+	host::reset(1000);
+	TrackingList* list = createList();
+	setTime(list, 0, 3600);
+	setTime(list, 2, 1800);
+	setTime(list, 5, 600);
+	CHECK(list->buildPair(0, 1));
+	list->resetIndex();
+	list->incIndex(2);
+	list->switchIndex();
+	host::advance(60);
+
+	TrackingList* same = createList();
+	CHECK(same->carryOver(*list));
+	CHECK_EQ(same->size(), 5);
+	CHECK(strcmp(same->getName(0), "work") == 0);
+	CHECK_EQ(same->at(0)->getTime(), 3600);
+	CHECK_EQ(same->getActiveIndex(), 1);
+	CHECK_EQ(same->at(1)->getTime(), 1800 + 60);
+	CHECK_EQ(same->totalTime(false), 3600 + 1800 + 60 + 600);
+	CHECK(same->totalsConsistent());
+	host::advance(60);
+	CHECK_EQ(same->updateTime(), 1800 + 120);
+
+	PairMap pairs;
+	pairs.insert("hardsimple", "work");
+	pairs.insert("workcalls", "desk");
+	TrackingList* changed = new TrackingList(4, pairs);
+	changed->addElement("hard", 0);
+	changed->addElement("simple", 0);
+	changed->addElement("calls", 1);
+	changed->addElement("distractions", 2);
+	CHECK(!changed->carryOver(*same));
+	CHECK_EQ(changed->size(), 3);
+	CHECK(strcmp(changed->getName(0), "work") == 0);
+	CHECK_EQ(changed->at(0)->getTime(), 3600);
+	CHECK_EQ(changed->at(1)->getTime(), 0);
+	CHECK_EQ(changed->at(2)->getTime(), 600);
+	CHECK_EQ(changed->getActiveIndex(), NULL_V);
+	CHECK_EQ(changed->totalTime(false), 4200);
+	CHECK(changed->totalsConsistent());
+	CHECK(changed->buildPair(0, 1));
+	CHECK(strcmp(changed->getName(0), "desk") == 0);
+	delete changed;
+	delete same;
+	delete list;
+}
+
+// A random binary tree over up to 64 leaves of random priorities, the same one for the same seed.
+static TrackingList* createRandomTree(unsigned seed) {
+	srand(seed);
+	int leaves = 2 + rand() % 63;
+	PairMap none;
+	TrackingList* list = new TrackingList(leaves, none);
+	char name[8];
+	vector<NodeIndex> roots;
+	for (int i = 0; i < leaves; ++i) {
+		snprintf(name, sizeof(name), "l%d", i);
+		list->addElement(name, rand() % 4);
+		roots.push_back(i);
+	}
+	for (int pairs = 0; roots.size() > 1; ++pairs) {
+		int i = rand() % (roots.size() - 1);
+		snprintf(name, sizeof(name), "p%d", pairs);
+		list->addPair(roots[i], roots[i + 1], name);
+		roots[i] = leaves + pairs;
+		roots.erase(roots.begin() + i + 1);
+	}
+	return list;
+}
+
+// Accrual, edits, merges and single splits in random order, so that pairs carry time their
+// elements do not account for at every level.
+static void shuffleTimes(TrackingList* list) {
+	for (int step = 0; step < 300; ++step) {
+		int index = rand() % list->size();
+		switch (rand() % 5) {
+			case 0:
+				list->resetIndex();
+				list->incIndex(index + 1);
+				list->switchIndex();
+				break;
+			case 1:
+				list->resetIndex();
+				list->incIndex(index + 1);
+				list->addTime(rand() % 7200 - 3600);
+				break;
+			case 2:
+			case 3:
+				if (index < list->size() - 1)
+					list->buildPair(index, index + 1);
+				break;
+			default:
+				if (rand() % 4 == 0)
+					list->breakPair(index);
+				host::advance(rand() % 600);
+				list->updateTime();
+				break;
+		}
+	}
+	list->resetIndex();
+}
+
+static bool sameRows(TrackingList* a, TrackingList* b) {
+	if (a->size() != b->size() || a->getUsedNodes() != b->getUsedNodes())
+		return false;
+	for (int i = 0; i < a->size(); ++i) {
+		if (a->getNode(i) != b->getNode(i) || a->at(i)->getTime() != b->at(i)->getTime())
+			return false;
+	}
+	return true;
+}
+
+static void testBreakTreeMatchesBreakPair() {
+	host::reset(1000);
+	// Larger than a persist key: a full tree of 64 leaves has 127 records.
+	schar buffer[1024];
+	for (unsigned seed = 1; seed <= 200; ++seed) {
+		TrackingList* list = createRandomTree(seed);
+		shuffleTimes(list);
+		int size = list->serialize(buffer, sizeof(buffer));
+		CHECK(size > 0);
+		TrackingList* levelByLevel = createRandomTree(seed);
+		TrackingList* onePass = createRandomTree(seed);
+		CHECK(levelByLevel->deserialize(buffer, size));
+		CHECK(onePass->deserialize(buffer, size));
+
+		int index = rand() % list->size();
+		int end = index + list->at(index)->getHeight();
+		for (int i = index; i < end; ++i) {
+			while (levelByLevel->at(i)->getHeight() > 1)
+				levelByLevel->breakPair(i);
+		}
+		CHECK_EQ(onePass->breakTree(index), list->at(index)->getHeight() > 1);
+		CHECK(sameRows(levelByLevel, onePass));
+
+		for (int i = 0; i < levelByLevel->size(); ++i) {
+			while (levelByLevel->at(i)->getHeight() > 1)
+				levelByLevel->breakPair(i);
+		}
+		CHECK(onePass->breakAll());
+		CHECK(sameRows(levelByLevel, onePass));
+		CHECK_EQ(onePass->size(), onePass->totalHeight());
+		CHECK(onePass->totalsConsistent());
+		for (int i = 0; i < onePass->size(); ++i)
+			CHECK(onePass->at(i)->getTime() >= 0);
+		delete onePass;
+		delete levelByLevel;
+		delete list;
+	}
+}
+
+// The totals and every row's node and time.
+static vector<int> visibleState(TrackingList* list) {
+	vector<int> state = { list->totalTime(), list->totalTime(false) };
+	for (int i = 0; i < list->size(); ++i) {
+		state.push_back(list->getNode(i));
+		state.push_back(list->at(i)->getTime());
+	}
+	return state;
+}
+
+// Undoing the merges shares the pair times out again, so the leaves come back only if undoing the
+// splits restored the times hidden under the pairs too.
+static void testUndoRedo() {
+	host::reset(1000);
+	TrackingList* list = createList();
+	for (int i = 0; i < 6; ++i)
+		setTime(list, i, 60 * (i + 1));
+	list->resetIndex();
+	list->endStep();
+	vector<vector<int>> states = { visibleState(list) };
+	list->buildAll();
+	list->endStep();
+	states.push_back(visibleState(list));
+	setTime(list, 0, 1000);
+	list->resetIndex();
+	list->endStep();
+	states.push_back(visibleState(list));
+	list->breakPair(0);
+	list->endStep();
+	states.push_back(visibleState(list));
+	setTime(list, 0, 30);
+	list->resetIndex();
+	list->endStep();
+	states.push_back(visibleState(list));
+	list->breakAll();
+	list->endStep();
+	states.push_back(visibleState(list));
+	list->resetTime(false);
+	list->endStep();
+	states.push_back(visibleState(list));
+	list->resetTime(true);
+	list->endStep();
+	states.push_back(visibleState(list));
+
+	for (int i = states.size() - 1; i > 0; --i) {
+		CHECK(list->undo());
+		CHECK(visibleState(list) == states[i - 1]);
+		CHECK(list->totalsConsistent());
+	}
+	for (size_t i = 1; i < states.size(); ++i) {
+		CHECK(list->redo());
+		CHECK(visibleState(list) == states[i]);
+	}
+	CHECK(!list->redo());
+	CHECK(list->undo());
+	CHECK(list->canRedo());
+	list->addTime(60);
+	CHECK(!list->canRedo());
+	delete list;
+}
+
+static void testUndoKeepsAccrual() {
+	host::reset(1000);
+	TrackingList* list = createList();
+	list->updateTime();
+	list->incIndex(1);
+	list->switchIndex();
+	list->resetIndex();
+	list->buildPair(0, 1);
+	list->endStep();
+	host::advance(100);
+	list->updateTime();
+	list->resetTime(false);
+	list->endStep();
+	CHECK_EQ(list->totalTime(), 100);
+	host::advance(50);
+	CHECK(list->undo());
+	CHECK_EQ(list->at(0)->getTime(), 150);
+	CHECK_EQ(list->totalTime(), 150);
+	CHECK(list->undo());
+	CHECK_EQ(list->size(), 6);
+	CHECK_EQ(list->getActiveIndex(), 0);
+	CHECK_EQ(list->totalTime(false), 150);
+	int hard = list->at(0)->getTime();
+	host::advance(10);
+	CHECK_EQ(list->updateTime(), hard + 10);
+	delete list;
+}
+
+// Edits of one node within a step add up; once the log is full the oldest steps go whole.
+static void testUndoCapacity() {
+	TrackingList* list = createList();
+	for (int i = 0; i < 100; ++i) {
+		setTime(list, i % 6, i);
+		list->endStep();
+	}
+	int undone = 0;
+	while (list->undo())
+		++undone;
+	CHECK_EQ(undone, 65);
+
+	setTime(list, 0, 100000);
+	list->resetIndex();
+	list->incIndex(1);
+	list->switchIndex();
+	list->incIndex();
+	list->endStep();
+	vector<vector<int>> states;
+	for (int i = 0; i < 40; ++i) {
+		states.push_back(visibleState(list));
+		list->addTime(60);
+		list->endStep();
+	}
+	undone = 0;
+	while (list->undo())
+		++undone;
+	CHECK_EQ(undone, 32);
+	CHECK(visibleState(list) == states[40 - 32]);
+	delete list;
+}
+
+static void testStringPool() {
+	StringPool pool;
+	NameId hard = pool.intern("hard");
+	CHECK_EQ(pool.intern("simple"), hard + 1);
+	CHECK_EQ(pool.intern("hard"), hard);
+	CHECK_EQ(pool.find("work"), NULL_NAME);
+	CHECK_EQ(pool.size(), 2);
+	CHECK_EQ(pool.getBytes(), 5 + 7);
+	StringPool copy = pool;
+	CHECK(strcmp(copy.get(hard + 1), "simple") == 0);
+	CHECK(copy.get(hard) != pool.get(hard));
+	StringPool empty;
+	StringPool emptyCopy = empty;
+	CHECK_EQ(emptyCopy.size(), 0);
+	copy = empty;
+	CHECK_EQ(copy.size(), 0);
+	CHECK_EQ(copy.find("hard"), NULL_NAME);
+}
+
+int main() {
+	RUN(testBuildAndBreak);
+	RUN(testBreakDistribution);
+	RUN(testTimeAccrual);
+	RUN(testSerialize);
+	RUN(testSerializeKeepsPairTime);
+	RUN(testDeserializeRejects);
+	RUN(testDeserializeLegacy);
+	RUN(testRunningTotals);
+	RUN(testNodeBlock);
+	RUN(testFullPairTable);
+	RUN(testLongNames);
+	RUN(testPairTable);
+	RUN(testConfig);
+	RUN(testConfigLimits);
+	RUN(testCarryOver);
+	RUN(testBreakTreeMatchesBreakPair);
+	RUN(testUndoRedo);
+	RUN(testUndoKeepsAccrual);
+	RUN(testUndoCapacity);
+	RUN(testStringPool);
+	return failures != 0;
+}